@@ -0,0 +1,420 @@
+// Keystroke-replay latency benchmark for the real AutoCompleteApp window,
+// run on Qt's offscreen platform.
+//
+//   keyreplay [--dictionary words.json] [--log keys.log] [options]
+//
+// A key log has one event per line: the time in ms since the start of the
+// session, "press" or "release", the key, and "repeat" for autorepeat
+// events. Keys are single characters or one of Space, Backspace, Delete,
+// Tab, Backtab and Return. Lines starting with '#' are ignored. Without
+// --log a seeded typing session is generated, including held-backspace
+// autorepeat bursts; --write-log saves it for later runs. --lines puts a
+// document of that many lines in the field first, and the session types
+// at its end.
+//
+// Latency is measured from the dispatch of a key press until
+// AutoCompleteApp has emitted suggestionsUpdated for it and the event loop
+// pass that delivered it is over. It includes any debounce or throttle
+// delay and the round trip to the completion worker thread, and whatever
+// else that pass processed, but not a paint scheduled for later. Presses
+// whose update is still pending when the next key arrives are reported as
+// coalesced.
+// Stalls are single event dispatches that block the event loop for a
+// millisecond or more.
+
+#include "autocompleteapp.h"
+#include "inputfield.h"
+#include "synthetic.h"
+
+#include <QApplication>
+#include <QCommandLineParser>
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QKeyEvent>
+#include <QTextCursor>
+#include <QTextDocument>
+#include <QStyleFactory>
+#include <QTemporaryDir>
+#include <QTextStream>
+
+#include <algorithm>
+#include <cstdio>
+#include <vector>
+
+namespace {
+
+struct KeyStroke {
+    qint64 at;
+    bool press;
+    int key;
+    QString text;
+    Qt::KeyboardModifiers modifiers;
+    bool autoRepeat;
+    QString name;
+};
+
+// Times every top-level event dispatch, i.e. every stretch of time the
+// event loop spends inside one handler.
+class ReplayApplication : public QApplication {
+  public:
+    using QApplication::QApplication;
+
+    bool notify(QObject *receiver, QEvent *event) override
+    {
+        if (depth++ > 0) {
+            bool handled = QApplication::notify(receiver, event);
+            --depth;
+            return handled;
+        }
+        QElapsedTimer timer;
+        timer.start();
+        bool handled = QApplication::notify(receiver, event);
+        --depth;
+        qint64 elapsed = timer.nsecsElapsed();
+        if (elapsed >= 1000000)
+            stalls.push_back(elapsed);
+        return handled;
+    }
+
+    std::vector<qint64> stalls;
+
+  private:
+    int depth = 0;
+};
+
+bool makeStroke(qint64 at, bool press, const QString &name, bool autoRepeat, KeyStroke &stroke)
+{
+    static const struct {
+        const char *name;
+        int key;
+        const char *text;
+        Qt::KeyboardModifiers modifiers;
+    } named[] = {
+        {"Space", Qt::Key_Space, " ", Qt::NoModifier},
+        {"Backspace", Qt::Key_Backspace, "", Qt::NoModifier},
+        {"Delete", Qt::Key_Delete, "", Qt::NoModifier},
+        {"Tab", Qt::Key_Tab, "\t", Qt::NoModifier},
+        {"Backtab", Qt::Key_Tab, "", Qt::ShiftModifier},
+        {"Return", Qt::Key_Return, "\r", Qt::NoModifier},
+    };
+    stroke = {at, press, 0, QString(), Qt::NoModifier, autoRepeat, name};
+    for (const auto &entry : named) {
+        if (name == QLatin1String(entry.name)) {
+            stroke.key = entry.key;
+            stroke.text = QString::fromLatin1(entry.text);
+            stroke.modifiers = entry.modifiers;
+            return true;
+        }
+    }
+    if (name.size() != 1)
+        return false;
+    QChar c = name[0];
+    stroke.key = c.toUpper().unicode();
+    stroke.text = name;
+    stroke.modifiers = c.isUpper() ? Qt::ShiftModifier : Qt::NoModifier;
+    return true;
+}
+
+bool readLog(const QString &fileName, std::vector<KeyStroke> &strokes)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        qCritical() << fileName << " couldn't be opened!";
+        return false;
+    }
+    QTextStream in(&file);
+    int lineNumber = 0;
+    while (!in.atEnd()) {
+        QString line = in.readLine().trimmed();
+        ++lineNumber;
+        if (line.isEmpty() || line.startsWith('#'))
+            continue;
+        QStringList fields = line.split(' ', Qt::SkipEmptyParts);
+        KeyStroke stroke;
+        if (fields.size() < 3 || (fields[1] != "press" && fields[1] != "release")
+            || !makeStroke(fields[0].toLongLong(), fields[1] == "press", fields[2],
+                           fields.size() > 3 && fields[3] == "repeat", stroke)) {
+            qCritical() << fileName << "line" << lineNumber << "is not a key event";
+            return false;
+        }
+        strokes.push_back(stroke);
+    }
+    return true;
+}
+
+void writeLog(const QString &fileName, const std::vector<KeyStroke> &strokes)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text)) {
+        qCritical() << fileName << " couldn't be opened!";
+        return;
+    }
+    QTextStream out(&file);
+    for (const KeyStroke &stroke : strokes) {
+        out << stroke.at << ' ' << (stroke.press ? "press" : "release") << ' ' << stroke.name;
+        if (stroke.autoRepeat)
+            out << " repeat";
+        out << '\n';
+    }
+}
+
+// The words of a dictionary file, most frequent first, for generating a
+// session against it.
+SyntheticDictionary readVocabulary(const QString &fileName)
+{
+    SyntheticDictionary vocabulary;
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text))
+        return vocabulary;
+    std::vector<std::pair<int, std::string>> entries;
+    try {
+        json data = json::parse(file.readAll().toStdString());
+        for (auto &[word, frequency] : data.items())
+            entries.emplace_back(frequency.get<int>(), word);
+    } catch (json::exception &e) {
+        qCritical() << "Error happen when parseing " << e.what();
+    }
+    std::sort(entries.begin(), entries.end(), [](const auto &a, const auto &b) { return a.first > b.first; });
+    for (auto &[frequency, word] : entries) {
+        vocabulary.frequencies.push_back(std::max(frequency, 1));
+        vocabulary.words.push_back(std::move(word));
+    }
+    return vocabulary;
+}
+
+// A typist at roughly 100 wpm writing Zipf-distributed words, accepting a
+// suggestion now and then and holding backspace to fix the odd word. Held
+// keys autorepeat the way X11 reports them: a release/press pair every
+// 33 ms after a 500 ms delay.
+std::vector<KeyStroke> generateSession(const SyntheticDictionary &dictionary, int presses, uint64_t seed)
+{
+    if (dictionary.words.empty())
+        return {};
+    std::mt19937_64 rng(seed);
+    size_t vocabulary = std::min<size_t>(dictionary.words.size(), 5000);
+    std::discrete_distribution<size_t> pickWord(dictionary.frequencies.begin(),
+                                                dictionary.frequencies.begin() + vocabulary);
+    std::normal_distribution<double> gap(110, 40);
+    std::uniform_int_distribution<int> percent(0, 99);
+    std::uniform_int_distribution<int> repeats(3, 12);
+
+    std::vector<KeyStroke> strokes;
+    qint64 t = 500;
+    int pressed = 0;
+    auto tap = [&](const QString &name) {
+        KeyStroke stroke;
+        makeStroke(t, true, name, false, stroke);
+        strokes.push_back(stroke);
+        makeStroke(t + 40, false, name, false, stroke);
+        strokes.push_back(stroke);
+        t += qint64(std::clamp(gap(rng), 30.0, 400.0));
+        ++pressed;
+    };
+
+    while (pressed < presses) {
+        const std::string &word = dictionary.words[pickWord(rng)];
+        for (QChar c : QString::fromStdString(word))
+            tap(QString(c));
+
+        int action = percent(rng);
+        if (action < 15) {
+            tap("Tab");
+            tap("Return");
+            continue;
+        }
+        if (action < 25) {
+            KeyStroke stroke;
+            makeStroke(t, true, "Backspace", false, stroke);
+            strokes.push_back(stroke);
+            t += 500;
+            for (int i = repeats(rng); i > 0; --i) {
+                makeStroke(t, false, "Backspace", true, stroke);
+                strokes.push_back(stroke);
+                makeStroke(t, true, "Backspace", true, stroke);
+                strokes.push_back(stroke);
+                t += 33;
+                ++pressed;
+            }
+            makeStroke(t, false, "Backspace", false, stroke);
+            strokes.push_back(stroke);
+            t += qint64(std::clamp(gap(rng), 30.0, 400.0));
+            ++pressed;
+        }
+        tap("Space");
+    }
+    // A fast typist presses the next key before releasing the last one.
+    std::stable_sort(strokes.begin(), strokes.end(),
+                     [](const KeyStroke &a, const KeyStroke &b) { return a.at < b.at; });
+    return strokes;
+}
+
+// Lines of eight dictionary words, cycling through the dictionary.
+QString makeDocument(const SyntheticDictionary &dictionary, int lines)
+{
+    QString text;
+    if (dictionary.words.empty())
+        return text;
+    size_t next = 0;
+    for (int line = 0; line < lines; ++line) {
+        for (int i = 0; i < 8; ++i) {
+            if (i > 0)
+                text += QLatin1Char(' ');
+            text += QString::fromStdString(dictionary.words[next++ % dictionary.words.size()]);
+        }
+        text += QLatin1Char('\n');
+    }
+    return text;
+}
+
+double percentile(std::vector<qint64> values, double p)
+{
+    if (values.empty())
+        return 0;
+    std::sort(values.begin(), values.end());
+    return double(values[size_t(p * double(values.size() - 1))]) / 1e6;
+}
+
+void report(const char *name, const std::vector<qint64> &values)
+{
+    std::printf("%-10s %8zu  p50 %8.3f ms  p95 %8.3f ms  p99 %8.3f ms  max %8.3f ms\n", name, values.size(),
+                percentile(values, 0.50), percentile(values, 0.95), percentile(values, 0.99),
+                percentile(values, 1.0));
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM"))
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    ReplayApplication app(argc, argv);
+    app.setStyle(QStyleFactory::create("Fusion"));
+
+    QCommandLineParser parser;
+    parser.addHelpOption();
+    QCommandLineOption dictionaryOption("dictionary", "Word frequency JSON to load.", "file");
+    QCommandLineOption wordsOption("words", "Size of the synthetic dictionary.", "count", "100000");
+    QCommandLineOption logOption("log", "Key log to replay.", "file");
+    QCommandLineOption keysOption("keys", "Key presses in a generated session.", "count", "500");
+    QCommandLineOption writeLogOption("write-log", "Save the replayed key log.", "file");
+    QCommandLineOption speedOption("speed", "Replay speed factor.", "factor", "1");
+    QCommandLineOption dfsOption("dfs", "Rank alphabetically instead of shortest first.");
+    QCommandLineOption noFreqOption("no-freq", "Do not rank by frequency.");
+    QCommandLineOption maxOption("max", "Maximum number of suggestions.", "count", "4");
+    QCommandLineOption linesOption("lines", "Lines of text in the field before the session.", "count", "0");
+    parser.addOptions({dictionaryOption, wordsOption, logOption, keysOption, writeLogOption, speedOption,
+                       dfsOption, noFreqOption, maxOption, linesOption});
+    parser.process(app);
+
+    Model model;
+    AutoCompleteApp window(&model);
+    QMetaObject::invokeMethod(&window, "onSettingsChanged", Qt::DirectConnection,
+                              Q_ARG(bool, !parser.isSet(dfsOption)),
+                              Q_ARG(int, parser.value(maxOption).toInt()),
+                              Q_ARG(bool, !parser.isSet(noFreqOption)));
+
+    SyntheticDictionary dictionary;
+    QTemporaryDir temporary;
+    QString dictionaryFile = parser.value(dictionaryOption);
+    if (!dictionaryFile.isEmpty()) {
+        dictionary = readVocabulary(dictionaryFile);
+        // The model journals the session's words next to the dictionary,
+        // snapshots it and autosaves over it, so it works on a copy.
+        QString copy = temporary.filePath("words_dictionary.json");
+        if (!QFile::copy(dictionaryFile, copy)) {
+            qCritical() << "Couldn't copy" << dictionaryFile << "to" << copy;
+            return 1;
+        }
+        dictionaryFile = copy;
+    } else {
+        dictionary = makeSyntheticDictionary(parser.value(wordsOption).toULongLong(), 42);
+        json data;
+        for (size_t i = 0; i < dictionary.words.size(); ++i)
+            data[dictionary.words[i]] = dictionary.frequencies[i];
+        dictionaryFile = temporary.filePath("words_dictionary.json");
+        QFile file(dictionaryFile);
+        if (file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+            std::string text = data.dump();
+            file.write(text.c_str(), text.size());
+        }
+    }
+    model.readJson(dictionaryFile);
+
+    std::vector<KeyStroke> strokes;
+    if (parser.isSet(logOption)) {
+        if (!readLog(parser.value(logOption), strokes))
+            return 1;
+    } else {
+        strokes = generateSession(dictionary, parser.value(keysOption).toInt(), 7);
+    }
+    if (strokes.empty()) {
+        qCritical() << "No key events to replay";
+        return 1;
+    }
+    if (parser.isSet(writeLogOption))
+        writeLog(parser.value(writeLogOption), strokes);
+
+    InputField *input = window.findChild<InputField *>("inputField");
+    window.show();
+    input->setFocus();
+    if (int lines = parser.value(linesOption).toInt(); lines > 0) {
+        QElapsedTimer loadTimer;
+        loadTimer.start();
+        input->setPlainText(makeDocument(dictionary, lines));
+        input->moveCursor(QTextCursor::End);
+        std::printf("%d line document (%d characters) in %.1f ms%s\n", lines, input->document()->characterCount(),
+                    double(loadTimer.nsecsElapsed()) / 1e6, input->isLargeDocument() ? ", large-document mode" : "");
+    }
+    app.processEvents();
+
+    bool pending = false;
+    bool updated = false;
+    int coalesced = 0;
+    qint64 pressedAt = 0;
+    std::vector<qint64> latencies;
+    QElapsedTimer clock;
+    QObject::connect(&window, &AutoCompleteApp::suggestionsUpdated, [&]() { updated = true; });
+    auto settle = [&]() {
+        app.processEvents();
+        if (pending && updated) {
+            latencies.push_back(clock.nsecsElapsed() - pressedAt);
+            pending = false;
+        }
+    };
+
+    double speed = std::max(parser.value(speedOption).toDouble(), 0.01);
+    app.stalls.clear();
+    clock.start();
+    for (const KeyStroke &stroke : strokes) {
+        qint64 due = qint64(double(stroke.at) * 1e6 / speed);
+        while (clock.nsecsElapsed() < due)
+            settle();
+        if (stroke.press) {
+            if (pending)
+                ++coalesced;
+            pending = true;
+            updated = false;
+            pressedAt = clock.nsecsElapsed();
+        }
+        QKeyEvent event(stroke.press ? QEvent::KeyPress : QEvent::KeyRelease, stroke.key, stroke.modifiers,
+                        stroke.text, stroke.autoRepeat);
+        QCoreApplication::sendEvent(input, &event);
+        settle();
+    }
+    // Let the last debounced update land.
+    qint64 end = clock.nsecsElapsed() + 500000000;
+    while (clock.nsecsElapsed() < end)
+        settle();
+    if (pending)
+        ++coalesced;
+
+    std::printf("%zu key events, %zu presses measured, %d coalesced\n", strokes.size(), latencies.size(),
+                coalesced);
+    report("latency", latencies);
+    report("stalls", app.stalls);
+    size_t frames = size_t(std::count_if(app.stalls.begin(), app.stalls.end(),
+                                         [](qint64 stall) { return stall > 16000000; }));
+    std::printf("%zu dispatches took longer than a 16 ms frame\n", frames);
+    return 0;
+}
@@ -0,0 +1,58 @@
+#pragma once
+#include <cmath>
+#include <cstdint>
+#include <iterator>
+#include <random>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+// Seeded synthetic dictionaries shared by the benchmarks: words drawn from
+// English letter frequencies, so the trie gets the shared prefixes and
+// uneven fan-out of a real dictionary, with Zipf-distributed frequencies.
+
+struct SyntheticDictionary {
+    std::vector<std::string> words;
+    std::vector<int> frequencies;
+    // Words of the same shape that are not in the dictionary.
+    std::vector<std::string> missing;
+};
+
+inline std::string syntheticWord(std::mt19937_64 &rng)
+{
+    static const char letters[] = "etaoinshrdlcumwfgypbvkjxqz";
+    static const double weights[] = {12.7, 9.1, 8.2, 7.5, 7.0, 6.7, 6.3, 6.1, 6.0, 4.3, 4.0, 2.8, 2.8,
+                                     2.4,  2.4, 2.2, 2.0, 2.0, 1.9, 1.5, 1.0, 0.8, 0.2, 0.2, 0.1, 0.1};
+    static std::discrete_distribution<int> letter(std::begin(weights), std::end(weights));
+    static std::discrete_distribution<int> length({0, 0, 2, 5, 8, 10, 11, 11, 10, 9, 8, 6, 5, 4, 3, 2, 1});
+    std::string word(size_t(length(rng)), ' ');
+    for (char &c : word)
+        c = letters[letter(rng)];
+    return word;
+}
+
+inline SyntheticDictionary makeSyntheticDictionary(size_t count, uint64_t seed, size_t missing = 0)
+{
+    std::mt19937_64 rng(seed);
+    SyntheticDictionary data;
+    std::unordered_set<std::string> seen;
+    seen.reserve(count * 2);
+    data.words.reserve(count);
+    while (data.words.size() < count) {
+        std::string word = syntheticWord(rng);
+        if (seen.insert(word).second)
+            data.words.push_back(std::move(word));
+    }
+    // Zipf: the word of rank r is used about 1 / r^1.07 as often as the
+    // most common one. Words are generated in random order, so their rank
+    // is their index.
+    data.frequencies.resize(count);
+    for (size_t r = 0; r < count; ++r)
+        data.frequencies[r] = 1 + int(1000000.0 / std::pow(double(r + 1), 1.07));
+    while (data.missing.size() < missing) {
+        std::string word = syntheticWord(rng);
+        if (!seen.count(word))
+            data.missing.push_back(std::move(word));
+    }
+    return data;
+}
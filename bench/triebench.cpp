@@ -0,0 +1,279 @@
+// Micro-benchmarks for the completion engine on synthetic dictionaries.
+//
+//   triebench [--uncompressed] [words...]
+//
+// Each dictionary size (10k, 100k, 1M and 5M words by default) gets words
+// drawn from English letter frequencies and Zipf-distributed frequencies.
+// Every operation is reported as ns/op and heap allocations/op, and each
+// size ends with the trie's memory use and the process's peak RSS. Runs are
+// seeded, so numbers from two builds are directly comparable.
+
+#include "trie.h"
+#include "dictionary.h"
+#include "synthetic.h"
+#ifdef TRIEBENCH_MODEL
+#include "model.h"
+#endif
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <new>
+#include <random>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+namespace {
+size_t allocations = 0;
+}
+
+void *operator new(size_t size)
+{
+    ++allocations;
+    if (void *p = std::malloc(size ? size : 1))
+        return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void *p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void *p, size_t) noexcept
+{
+    std::free(p);
+}
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+size_t sink = 0;
+
+size_t peakRssKb()
+{
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters));
+    return counters.PeakWorkingSetSize / 1024;
+#else
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+    return size_t(usage.ru_maxrss) / 1024;
+#else
+    return size_t(usage.ru_maxrss);
+#endif
+#endif
+}
+
+template <typename F>
+void measure(const std::string &name, size_t ops, F f)
+{
+    size_t before = allocations;
+    Clock::time_point start = Clock::now();
+    f();
+    double ns = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+    size_t allocs = allocations - before;
+    std::printf("  %-40s %12.1f ns/op %10.2f allocs/op\n", name.c_str(), ns / double(ops ? ops : 1),
+                double(allocs) / double(ops ? ops : 1));
+    std::fflush(stdout);
+}
+
+std::vector<std::string> makePrefixes(const SyntheticDictionary &data, size_t count, std::mt19937_64 &rng)
+{
+    std::vector<std::string> prefixes;
+    prefixes.reserve(count);
+    std::uniform_int_distribution<size_t> pick(0, data.words.size() - 1);
+    std::uniform_int_distribution<size_t> length(1, 4);
+    while (prefixes.size() < count) {
+        const std::string &word = data.words[pick(rng)];
+        prefixes.push_back(word.substr(0, std::min(word.size(), length(rng))));
+    }
+    return prefixes;
+}
+
+// Wildcard queries shaped like what users type: a dot in place of an
+// unsure letter, a star in the middle, and a leading star.
+std::vector<std::string> makePatterns(const SyntheticDictionary &data, size_t count, std::mt19937_64 &rng)
+{
+    std::vector<std::string> patterns;
+    patterns.reserve(count);
+    std::uniform_int_distribution<size_t> pick(0, data.words.size() - 1);
+    while (patterns.size() < count) {
+        std::string word = data.words[pick(rng)];
+        switch (patterns.size() % 3) {
+        case 0:
+            word[word.size() / 2] = '.';
+            break;
+        case 1:
+            word = word.substr(0, 2) + "*" + word.substr(word.size() - 1);
+            break;
+        default:
+            word = "*" + word.substr(word.size() - std::min<size_t>(word.size(), 3));
+            break;
+        }
+        patterns.push_back(word);
+    }
+    return patterns;
+}
+
+void runSize(size_t count, bool compressed)
+{
+    std::printf("%zu words (%s)\n", count, compressed ? "compressed" : "uncompressed");
+    SyntheticDictionary data = makeSyntheticDictionary(count, 42 + count, 100000);
+    std::mt19937_64 rng(7);
+    std::vector<std::string> prefixes = makePrefixes(data, 100000, rng);
+    std::vector<std::string> patterns = makePatterns(data, 90, rng);
+    std::uniform_int_distribution<size_t> pick(0, data.words.size() - 1);
+
+    Trie trie(compressed);
+    measure("insert", count, [&] {
+        for (size_t i = 0; i < count; ++i)
+            trie.insert(data.words[i], data.frequencies[i]);
+    });
+
+    measure("contain (hit)", 100000, [&] {
+        for (size_t i = 0; i < 100000; ++i)
+            sink += trie.contain(data.words[pick(rng)]);
+    });
+    measure("contain (miss)", data.missing.size(), [&] {
+        for (const std::string &word : data.missing)
+            sink += trie.contain(word);
+    });
+
+    QueryContext context;
+    std::string_view out[10];
+    for (int bfs = 0; bfs < 2; ++bfs) {
+        for (int usefreq = 0; usefreq < 2; ++usefreq) {
+            for (int max : {1, 4, 10}) {
+                char name[64];
+                std::snprintf(name, sizeof(name), "autoComplete bfs=%d freq=%d max=%d", bfs, usefreq, max);
+                size_t queries = prefixes.size();
+                measure(name, queries, [&] {
+                    for (size_t i = 0; i < queries; ++i)
+                        sink += trie.autoComplete(prefixes[i], bfs, usefreq, max).size();
+                });
+                std::strcat(name, " (context)");
+                measure(name, queries, [&] {
+                    for (size_t i = 0; i < queries; ++i)
+                        sink += trie.autoComplete(context, prefixes[i], bfs, usefreq, out, size_t(max));
+                });
+            }
+        }
+    }
+    for (int bfs = 0; bfs < 2; ++bfs) {
+        for (int usefreq = 0; usefreq < 2; ++usefreq) {
+            char name[64];
+            std::snprintf(name, sizeof(name), "wildcard bfs=%d freq=%d max=4", bfs, usefreq);
+            measure(name, patterns.size(), [&] {
+                for (const std::string &pattern : patterns)
+                    sink += trie.autoComplete(pattern, bfs, usefreq, 4).size();
+            });
+        }
+    }
+
+    // addNew() only inserts a word on its third sighting.
+    size_t added = std::min<size_t>(data.missing.size(), 30000);
+    measure("addNew", added * 3, [&] {
+        for (int round = 0; round < 3; ++round) {
+            for (size_t i = 0; i < added; ++i)
+                trie.addNew(data.missing[i]);
+        }
+    });
+
+    std::string text;
+    measure("Dictionary::serialize", count, [&] { text = Dictionary::serialize(trie); });
+    measure("Dictionary::serialize (compact)", count, [&] {
+        sink += Dictionary::serialize(trie, Dictionary::Style::Compact).size();
+    });
+    measure("Dictionary::parse", count, [&] {
+        Trie loaded(compressed);
+        Dictionary::parse(text, loaded);
+        sink += loaded.size();
+    });
+    std::string snapshot = "triebench_dictionary.snapshot";
+    measure("Trie::saveSnapshot", count, [&] { sink += trie.saveSnapshot(snapshot, count); });
+    measure("Trie::loadSnapshot", count, [&] {
+        Trie loaded(compressed);
+        sink += loaded.loadSnapshot(snapshot, count);
+    });
+    measure("Trie::loadSnapshot (verified)", count, [&] {
+        Trie loaded(compressed);
+        sink += loaded.loadSnapshot(snapshot, count, true);
+    });
+    std::remove(snapshot.c_str());
+
+    std::string path = "triebench_dictionary.json";
+    std::ofstream(path, std::ios::binary) << text;
+    text.clear();
+    text.shrink_to_fit();
+#ifdef TRIEBENCH_MODEL
+    measure("Model::readJson", count, [&] {
+        Trie loaded(compressed);
+        Model model;
+        model.loadTrie(&loaded);
+        model.readJson(QString::fromStdString(path));
+        sink += loaded.size();
+    });
+    measure("Model::saveJson", count, [&] {
+        Model model;
+        model.loadTrie(&trie);
+        model.saveJson(QString::fromStdString(path));
+    });
+    std::remove((path + ".backup").c_str());
+    std::remove((path + ".snapshot").c_str());
+    std::remove((path + ".journal").c_str());
+#endif
+    std::remove(path.c_str());
+
+    measure("reset", 3, [&] {
+        for (int i = 0; i < 3; ++i)
+            trie.reset();
+    });
+    measure("decay", 3, [&] {
+        for (int i = 0; i < 3; ++i)
+            trie.decay(1);
+    });
+
+    size_t removals = std::min<size_t>(count, 100000);
+    measure("remove", removals, [&] {
+        for (size_t i = 0; i < removals; ++i)
+            sink += trie.remove(data.words[i]);
+    });
+
+    std::printf("  trie memory %.1f MB (%.1f bytes/word), peak RSS %.1f MB\n\n",
+                double(trie.memoryUsage()) / (1024 * 1024), trie.bytesPerWord(),
+                double(peakRssKb()) / 1024);
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    bool compressed = true;
+    std::vector<size_t> sizes;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--uncompressed") == 0)
+            compressed = false;
+        else
+            sizes.push_back(size_t(std::strtoull(argv[i], nullptr, 10)));
+    }
+    if (sizes.empty())
+        sizes = {10000, 100000, 1000000, 5000000};
+
+    for (size_t count : sizes)
+        runSize(count, compressed);
+    return sink == 42 ? 1 : 0;
+}
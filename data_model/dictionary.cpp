@@ -0,0 +1,160 @@
+#include "dictionary.h"
+#include <charconv>
+#include <fstream>
+#include <sstream>
+#include <utility>
+#include <vector>
+
+namespace {
+// SAX handler that passes the "word": frequency pairs of a dictionary on
+// as they arrive.
+class Inserter : public nlohmann::json_sax<json>
+{
+public:
+    using Entry = std::function<void(std::string &word, int frequency)>;
+
+    explicit Inserter(Entry entry) : entry(std::move(entry)) {}
+
+    bool null() override { return reject("null"); }
+    bool boolean(bool) override { return reject("boolean"); }
+    bool number_integer(number_integer_t val) override { return insert(int(val)); }
+    bool number_unsigned(number_unsigned_t val) override { return insert(int(val)); }
+    bool number_float(number_float_t val, const string_t &) override { return insert(int(val)); }
+    bool string(string_t &) override { return reject("string"); }
+    bool binary(binary_t &) override { return reject("binary"); }
+    bool start_array(std::size_t) override { return reject("array"); }
+    bool end_array() override { return true; }
+
+    bool start_object(std::size_t) override
+    {
+        if (inObject)
+            return reject("object");
+        inObject = true;
+        return true;
+    }
+
+    bool end_object() override { return true; }
+
+    bool key(string_t &val) override
+    {
+        word.swap(val);
+        return true;
+    }
+
+    // `ex` arrives as the base class, so throwing it as is would slice it.
+    // The parser only reports parse_error and out_of_range.
+    bool parse_error(std::size_t position, const std::string &, const nlohmann::detail::exception &ex) override
+    {
+        if (auto *error = dynamic_cast<const json::parse_error *>(&ex))
+            throw *error;
+        if (auto *error = dynamic_cast<const json::out_of_range *>(&ex))
+            throw *error;
+        throw json::parse_error::create(101, position, ex.what(), nullptr);
+    }
+
+private:
+    Entry entry;
+    std::string word;
+    bool inObject = false;
+
+    bool insert(int frequency)
+    {
+        if (!inObject)
+            return reject("number");
+        entry(word, frequency);
+        return true;
+    }
+
+    bool reject(const char *type)
+    {
+        if (!inObject)
+            throw json::type_error::create(302, "dictionary must be an object, but is " + std::string(type), nullptr);
+        throw json::type_error::create(302, "type must be number, but is " + std::string(type), nullptr);
+    }
+};
+}
+
+void Dictionary::read(std::istream &in, Trie &trie)
+{
+    read(in, [&trie](std::string &word, int frequency) { trie.assign(word, frequency); });
+    trie.changed = false;
+}
+
+void Dictionary::read(std::istream &in, const std::function<void(std::string &word, int frequency)> &entry)
+{
+    Inserter inserter(entry);
+    json::sax_parse(in, &inserter);
+}
+
+void Dictionary::parse(const std::string &text, Trie &trie)
+{
+    Inserter inserter([&trie](std::string &word, int frequency) { trie.assign(word, frequency); });
+    json::sax_parse(text, &inserter);
+    trie.changed = false;
+}
+
+Dictionary::Writer::Writer(std::ostream &out, Style style) : out(out), style(style) {}
+
+void Dictionary::Writer::add(std::string_view word, int frequency)
+{
+    line.clear();
+    if (style == Style::Pretty)
+        line.append(first ? "{\n    " : ",\n    ");
+    else
+        line.append(first ? "{" : ",");
+    first = false;
+
+    // Plain ASCII is written as it is; anything json::dump() might escape
+    // or reject is left to it.
+    bool plain = true;
+    for (unsigned char c : word)
+        plain = plain && c >= 0x20 && c < 0x80 && c != '"' && c != '\\';
+    if (plain) {
+        line.push_back('"');
+        line.append(word);
+        line.push_back('"');
+    } else {
+        line.append(json(std::string(word)).dump());
+    }
+    line.append(style == Style::Pretty ? ": " : ":");
+
+    char number[16];
+    line.append(number, std::to_chars(number, number + sizeof(number), frequency).ptr);
+    out.write(line.data(), std::streamsize(line.size()));
+}
+
+bool Dictionary::Writer::finish()
+{
+    if (first)
+        out << "{}";
+    else
+        out << (style == Style::Pretty ? "\n}" : "}");
+    out.flush();
+    return bool(out);
+}
+
+bool Dictionary::write(std::ostream &out, const Trie &trie, Style style)
+{
+    Writer writer(out, style);
+    trie.forEachEntry([&writer](std::string_view word, int frequency) { writer.add(word, frequency); });
+    return writer.finish();
+}
+
+std::string Dictionary::serialize(const Trie &trie, Style style)
+{
+    std::ostringstream out;
+    write(out, trie, style);
+    return out.str();
+}
+
+bool Dictionary::load(const std::string &fileName, Trie &trie)
+{
+    std::vector<char> buffer(1 << 16);
+    std::ifstream file;
+    file.rdbuf()->pubsetbuf(buffer.data(), std::streamsize(buffer.size()));
+    file.open(fileName, std::ios::binary);
+    if (!file)
+        return false;
+    read(file, trie);
+    return true;
+}
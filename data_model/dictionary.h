@@ -0,0 +1,50 @@
+#pragma once
+#include <functional>
+#include <istream>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include "../headers/trie.h"
+
+// Reading and writing the word -> frequency JSON dictionaries a Trie is
+// loaded from, with no Qt dependency. Reading is streamed: each entry is
+// assigned to the trie as soon as the parser reaches it, without building
+// a JSON document, so a repeated key keeps its last value as it would in
+// one. Malformed input throws json::exception; the entries before the
+// error stay inserted. Writing is streamed the same way, straight from the
+// trie to the output.
+class Dictionary
+{
+public:
+    // Pretty is what json::dump(4) writes, Compact what json::dump() does.
+    enum class Style { Pretty, Compact };
+
+    // Writes a dictionary entry by entry, byte for byte as json::dump()
+    // would write the same entries, without building a document. Entries
+    // must come in byte-wise order, as a trie hands them out. Words that
+    // are not valid UTF-8 throw json::exception.
+    class Writer
+    {
+    public:
+        explicit Writer(std::ostream &out, Style style = Style::Pretty);
+        void add(std::string_view word, int frequency);
+        // Closes the object and flushes; false if the stream failed.
+        bool finish();
+
+    private:
+        std::ostream &out;
+        Style style;
+        bool first = true;
+        std::string line;
+    };
+
+    static void read(std::istream &in, Trie &trie);
+    // Hands each entry to `entry` instead of inserting it.
+    static void read(std::istream &in, const std::function<void(std::string &word, int frequency)> &entry);
+    static void parse(const std::string &text, Trie &trie);
+    // Returns false if the stream failed.
+    static bool write(std::ostream &out, const Trie &trie, Style style = Style::Pretty);
+    static std::string serialize(const Trie &trie, Style style = Style::Pretty);
+    // Returns false if the file cannot be read.
+    static bool load(const std::string &fileName, Trie &trie);
+};
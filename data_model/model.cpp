@@ -1,13 +1,191 @@
 #include "model.h"
+#include "dictionary.h"
 #include <QFile>
+#include <QFileInfo>
+#include <QDateTime>
 #include <QDebug>
-#include <../assets/json.hpp>
+#include <QElapsedTimer>
+#include <QSaveFile>
+#include <QSettings>
+#include <QTimer>
+#include <algorithm>
+#include <functional>
+#include <istream>
+#include <ostream>
 
-using json = nlohmann::json;
-Model::Model(){}
+namespace {
+// Lets the dictionary parser pull a QIODevice, and the dictionary writer
+// push to one, in fixed-size chunks.
+class DeviceBuffer : public std::streambuf
+{
+public:
+    explicit DeviceBuffer(QIODevice *device) : device(device) {}
+
+protected:
+    int_type underflow() override
+    {
+        qint64 read = device->read(buffer, sizeof(buffer));
+        if (read <= 0)
+            return traits_type::eof();
+        setg(buffer, buffer, buffer + read);
+        return traits_type::to_int_type(buffer[0]);
+    }
+
+    int_type overflow(int_type c) override
+    {
+        if (sync() != 0)
+            return traits_type::eof();
+        if (!traits_type::eq_int_type(c, traits_type::eof())) {
+            *pptr() = traits_type::to_char_type(c);
+            pbump(1);
+        }
+        return traits_type::not_eof(c);
+    }
+
+    int sync() override
+    {
+        qint64 pending = pptr() - pbase();
+        if (pending > 0 && device->write(pbase(), pending) != pending)
+            return -1;
+        setp(buffer, buffer + sizeof(buffer));
+        return 0;
+    }
+
+private:
+    QIODevice *device;
+    char buffer[1 << 16];
+};
+
+// A snapshot sits next to its dictionary and is only used while the
+// dictionary still has the size and modification time it was built from.
+std::string snapshotName(const QString &fileName)
+{
+    return QFile::encodeName(fileName + ".snapshot").toStdString();
+}
+
+std::string journalName(const QString &fileName)
+{
+    return QFile::encodeName(fileName + ".journal").toStdString();
+}
+
+uint64_t snapshotSource(const QString &fileName)
+{
+    QFileInfo info(fileName);
+    return (uint64_t(info.size()) << 40) ^ uint64_t(info.lastModified().toMSecsSinceEpoch());
+}
+
+// Entries per batch handed from the loader thread to the model's thread,
+// and how long the model's thread spends inserting before it lets other
+// events through.
+constexpr size_t batchSize = 8192;
+constexpr qint64 insertBudgetMs = 8;
+// Journal size at which save() folds it into the dictionary.
+constexpr size_t compactBytes = size_t(1) << 20;
+
+struct Cancelled {};
+
+// Replaces the dictionary so that a crash leaves either the old file or the
+// new one: QSaveFile writes a temporary file, syncs it and renames it over
+// the original on commit(). The dictionary is streamed into the file by
+// `write`, so memory use does not grow with its size.
+bool writeDictionary(const QString &fileName, const std::function<bool(std::ostream &)> &write)
+{
+    QString backUpName = fileName + ".backup";
+    if (QFile::exists(fileName)) {
+        QFile::remove(backUpName);
+        QFile::copy(fileName, backUpName);
+    }
+
+    QSaveFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly))
+        return false;
+    DeviceBuffer buffer(&file);
+    std::ostream out(&buffer);
+    try {
+        if (!write(out)) {
+            file.cancelWriting();
+            return false;
+        }
+    } catch (const json::exception &e) {
+        qCritical() << "Couldn't write" << fileName << ":" << e.what();
+        file.cancelWriting();
+        return false;
+    }
+    return file.commit();
+}
+}
+
+Model::Model()
+{
+    autosaveTimer = new QTimer(this);
+    connect(autosaveTimer, &QTimer::timeout, this, [this]() {
+        applyDecay();
+        // Journaled changes are kept already; the dictionary is only
+        // rewritten once folding the journal into it pays off.
+        if (trie && (journal.isOpen() ? journal.bytes() > compactBytes : trie->changed))
+            saveAsync();
+    });
+    setAutosaveInterval(5);
+}
+
+Model::~Model()
+{
+    cancelled = true;
+    if (loader.joinable())
+        loader.join();
+    waitForSave();
+    // Left until now so that saves never stall the UI; only valid while
+    // the trie holds exactly what is in the file.
+    if (trie && snapshotStale && !discarded && journal.isOpen() && journal.empty()) {
+        // Sessions that removed a lot would otherwise hand their holes on
+        // to every later one through the snapshot.
+        auto edit = trie->lockForEdit();
+        if (trie->releasedNodes() > trie->nodeCount() / 8)
+            trie->compact();
+        trie->saveSnapshot(snapshotName(dictionaryFile), snapshotSource(dictionaryFile));
+    }
+}
+
+void Model::openJournal(const QString &fileName)
+{
+    if (journal.open(journalName(fileName), snapshotSource(fileName)))
+        trie->setJournal(&journal);
+    else
+        qWarning() << "Couldn't open the journal of" << fileName;
+}
+
+void Model::replayJournal()
+{
+    auto edit = trie->lockForEdit();
+    // Replayed changes are already saved, and must not be journaled again.
+    bool changed = trie->changed;
+    trie->setJournal(nullptr);
+    size_t records = journal.replay(*trie);
+    if (journal.isOpen())
+        trie->setJournal(&journal);
+    trie->changed = changed;
+    if (records)
+        qDebug() << "Replayed" << records << "journal records";
+}
+
+bool Model::mapSnapshot(const QString &fileName)
+{
+    auto edit = trie->lockForEdit();
+    return QFile::exists(fileName) && trie->loadSnapshot(snapshotName(fileName), snapshotSource(fileName));
+}
 
 void Model::readJson(const QString &fileName)
 {
+    dictionaryFile = fileName;
+    trie->setJournal(nullptr);
+    if (mapSnapshot(fileName)) {
+        qDebug() << "Mapped snapshot of" << fileName << "with" << trie->size() << "words";
+        openJournal(fileName);
+        replayJournal();
+        applyDecay();
+        return;
+    }
+
     QFile file(fileName);
     if (file.open(QIODevice::ReadOnly | QIODevice::Text)) {
         qDebug() << "Opened file:" << fileName;
@@ -18,34 +196,313 @@ void Model::readJson(const QString &fileName)
         return;
     }
     try {
-        json jsonData = json::parse(file.readAll().toStdString());
-        for (auto &[word, frequency] : jsonData.items()) {
-            trie->insert(word, frequency);
+        DeviceBuffer buffer(&file);
+        std::istream in(&buffer);
+        {
+            auto edit = trie->lockForEdit();
+            Dictionary::read(in, *trie);
+            qDebug() << "Loaded" << trie->size() << "words in" << trie->nodeCount() << "nodes,"
+                     << trie->bytesPerWord() << "bytes/word";
         }
-        trie->changed = false;
+        file.close();
+        if (!trie->saveSnapshot(snapshotName(fileName), snapshotSource(fileName)))
+            qWarning() << "Couldn't write a snapshot of" << fileName;
+        openJournal(fileName);
+        replayJournal();
+        applyDecay();
     } catch (json::exception &e) {
         qCritical() << "Error happen when parseing " << e.what();
     }
 }
 
+void Model::loadAsync(const QString &fileName)
+{
+    if (loading)
+        return;
+    dictionaryFile = fileName;
+    if (mapSnapshot(fileName)) {
+        qDebug() << "Mapped snapshot of" << fileName << "with" << trie->size() << "words";
+        openJournal(fileName);
+        replayJournal();
+        applyDecay();
+        QMetaObject::invokeMethod(this, [this]() {
+            emit loadProgress(100);
+            emit loadFinished(true);
+        }, Qt::QueuedConnection);
+        return;
+    }
+
+    trie->setJournal(nullptr);
+    loading = true;
+    loadError.clear();
+    cancelled = false;
+    loaderDone = false;
+    bytesTotal = QFileInfo(fileName).size();
+    // Changes made while loading are journaled right away; the records
+    // from earlier sessions are replayed once the dictionary is in.
+    openJournal(fileName);
+    loader = std::thread([this, fileName]() {
+        QFile file(fileName);
+        if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+            loadError = "couldn't be opened";
+        } else {
+            // Whoever finds the queue empty schedules insertPending(), so
+            // there is at most one call queued at a time.
+            Batch batch;
+            auto post = [&]() {
+                batch.position = file.pos();
+                bool wasEmpty;
+                {
+                    std::lock_guard<std::mutex> lock(pendingMutex);
+                    wasEmpty = pending.empty();
+                    pending.push_back(std::move(batch));
+                }
+                if (wasEmpty)
+                    QMetaObject::invokeMethod(this, [this]() { insertPending(); }, Qt::QueuedConnection);
+                batch = Batch();
+                batch.entries.reserve(batchSize);
+            };
+            try {
+                DeviceBuffer buffer(&file);
+                std::istream in(&buffer);
+                batch.entries.reserve(batchSize);
+                Dictionary::read(in, [&](std::string &word, int frequency) {
+                    if (cancelled)
+                        throw Cancelled();
+                    batch.entries.emplace_back(std::move(word), frequency);
+                    if (batch.entries.size() == batchSize)
+                        post();
+                });
+                post();
+            } catch (std::exception &e) {
+                loadError = e.what();
+            } catch (Cancelled &) {
+            }
+        }
+        loaderDone = true;
+        QMetaObject::invokeMethod(this, [this]() { insertPending(); }, Qt::QueuedConnection);
+    });
+}
+
+void Model::insertPending()
+{
+    // Read first: once the loader is done, an empty queue means everything
+    // has been inserted.
+    bool done = loaderDone;
+    QElapsedTimer elapsed;
+    elapsed.start();
+    auto edit = trie->lockForEdit();
+    // Entries from the file are not unsaved changes.
+    bool changed = trie->changed;
+    trie->setJournal(nullptr);
+    bool more = true;
+    qint64 position = -1;
+    while (more && elapsed.elapsed() < insertBudgetMs) {
+        Batch batch;
+        {
+            std::lock_guard<std::mutex> lock(pendingMutex);
+            if (pending.empty()) {
+                more = false;
+                break;
+            }
+            batch = std::move(pending.front());
+            pending.pop_front();
+            more = !pending.empty();
+        }
+        for (const auto &entry : batch.entries)
+            trie->assign(entry.first, entry.second);
+        position = batch.position;
+    }
+    if (journal.isOpen())
+        trie->setJournal(&journal);
+    trie->changed = changed;
+    edit.unlock();
+    if (position >= 0 && bytesTotal > 0)
+        emit loadProgress(int(qMin<qint64>(99, position * 100 / bytesTotal)));
+
+    bool remaining;
+    {
+        std::lock_guard<std::mutex> lock(pendingMutex);
+        remaining = !pending.empty();
+    }
+    // Batches that arrived after the queue was found empty have been
+    // scheduled by the loader already.
+    if (remaining && more)
+        QMetaObject::invokeMethod(this, [this]() { insertPending(); }, Qt::QueuedConnection);
+    else if (done && !remaining && loading)
+        finishLoad();
+}
+
+void Model::finishLoad()
+{
+    if (loader.joinable())
+        loader.join();
+    loading = false;
+    bool ok = loadError.empty() && !cancelled;
+    if (ok) {
+        {
+            auto edit = trie->lockForEdit();
+            qDebug() << "Loaded" << trie->size() << "words in" << trie->nodeCount() << "nodes,"
+                     << trie->bytesPerWord() << "bytes/word";
+            // Only a trie that still matches the file may be stamped with it.
+            if (!trie->changed && !trie->saveSnapshot(snapshotName(dictionaryFile), snapshotSource(dictionaryFile)))
+                qWarning() << "Couldn't write a snapshot of" << dictionaryFile;
+        }
+        replayJournal();
+        applyDecay();
+        emit loadProgress(100);
+    } else if (!cancelled) {
+        qCritical() << "Error loading" << dictionaryFile << ":" << QString::fromStdString(loadError);
+    }
+    emit loadFinished(ok);
+    if (saveQueued && ok)
+        saveAsync();
+}
+
+void Model::waitForLoad()
+{
+    if (!loading)
+        return;
+    loader.join();
+    while (loading)
+        insertPending();
+}
+
 void Model::saveJson(const QString &fileName) {
-    json data;
-    trie->makeJson(data);
+    // Saving a half-loaded trie would drop the rest of the dictionary.
+    waitForLoad();
+    waitForSave();
+    if (writeDictionary(fileName, [this](std::ostream &out) { return Dictionary::write(out, *trie); })) {
+        if (fileName == dictionaryFile)
+            snapshotStale = false;
+        if (!trie->saveSnapshot(snapshotName(fileName), snapshotSource(fileName)))
+            qWarning() << "Couldn't write a snapshot of" << fileName;
+        // Everything journaled is in the dictionary now.
+        if (fileName == dictionaryFile && journal.isOpen() && !journal.clear(snapshotSource(fileName)))
+            qWarning() << "Couldn't clear the journal of" << fileName;
+    }
+}
 
-    QString backUpName = fileName + ".backup";
+void Model::save()
+{
+    waitForLoad();
+    if (dictionaryFile.isEmpty())
+        return;
+    if (!journal.isOpen() || journal.bytes() > compactBytes)
+        saveAsync();
+    trie->changed = false;
+}
 
-    // Create backup
-    if (QFile::exists(fileName)) {
-        QFile::remove(backUpName);
-        QFile::copy(fileName, backUpName);
+void Model::discard()
+{
+    // The saver reads the journal's size.
+    waitForSave();
+    if (journal.isOpen() && !journal.rollback())
+        qWarning() << "Couldn't roll back the journal of" << dictionaryFile;
+    // The trie still holds what was dropped, so it must neither be saved
+    // nor snapshotted as the dictionary from now on.
+    discarded = true;
+    autosaveTimer->stop();
+}
+
+void Model::saveAsync()
+{
+    if (dictionaryFile.isEmpty() || discarded)
+        return;
+    // A half-loaded trie is saved once it is complete.
+    if (saving || loading) {
+        saveQueued = true;
+        return;
     }
+    saving = true;
+    saveQueued = false;
+    saverDone = false;
+    saver = std::thread([this, fileName = dictionaryFile]() {
+        // Edits only wait for the copy, which the file, the snapshot and
+        // the journal offset all describe; nothing is written under the
+        // lock.
+        Trie copy;
+        {
+            auto view = trie->lockForRead();
+            copy.copyFrom(*trie);
+            saveMark = journal.bytes();
+        }
+        saveOk = writeDictionary(fileName, [&copy](std::ostream &out) { return Dictionary::write(out, copy); });
+        // The snapshot can only be stamped once the file is in place.
+        snapshotSaved = saveOk && copy.saveSnapshot(snapshotName(fileName), snapshotSource(fileName));
+        saverDone = true;
+        QMetaObject::invokeMethod(this, [this]() { finishSave(); }, Qt::QueuedConnection);
+    });
+}
 
-    QFile file(fileName);
-    if (file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
-        std::string jsonStr = data.dump(4);
-        file.write(jsonStr.c_str(), jsonStr.size());
-        file.close();
+void Model::finishSave()
+{
+    // Also called by waitForSave(), which leaves the queued call with
+    // nothing to do, or with a later save that is still running.
+    if (!saving || !saverDone)
+        return;
+    if (saver.joinable())
+        saver.join();
+    saving = false;
+    bool ok = saveOk;
+    if (ok) {
+        // Changes made since the copy are not in the file and stay in the
+        // journal.
+        if (journal.isOpen() && !journal.rebase(saveMark, snapshotSource(dictionaryFile)))
+            qWarning() << "Couldn't rebase the journal of" << dictionaryFile;
+        snapshotStale = !snapshotSaved;
+    } else {
+        qCritical() << "Couldn't save" << dictionaryFile;
+    }
+    emit saveFinished(ok);
+    if (saveQueued)
+        saveAsync();
+}
+
+void Model::waitForSave()
+{
+    while (saving) {
+        saver.join();
+        finishSave();
+    }
+}
+
+void Model::setAutosaveInterval(int minutes)
+{
+    if (minutes > 0)
+        autosaveTimer->start(minutes * 60 * 1000);
+    else
+        autosaveTimer->stop();
+}
+
+void Model::setDecayHalfLife(int days)
+{
+    decayDays = std::max(days, 0);
+    // Decay counts from when it was turned on, not from an old stamp.
+    if (decayDays == 0)
+        QSettings().remove("Frequency/LastDecay");
+    else
+        applyDecay();
+}
+
+// The trie ages in O(1) per call, so this is cheap enough for every load
+// and autosave tick. The stamp only advances by whole half-lives, so the
+// remainder carries over to the next call.
+void Model::applyDecay()
+{
+    // Before a load is done, the stamp would move on without the words.
+    if (!trie || decayDays == 0 || loading || dictionaryFile.isEmpty())
+        return;
+    QSettings settings;
+    qint64 now = QDateTime::currentSecsSinceEpoch();
+    qint64 last = settings.value("Frequency/LastDecay", now).toLongLong();
+    qint64 period = qint64(decayDays) * 24 * 60 * 60;
+    qint64 halvings = last < now ? (now - last) / period : 0;
+    if (halvings > 0) {
+        auto edit = trie->lockForEdit();
+        trie->decay(unsigned(std::min<qint64>(halvings, 32)));
     }
+    settings.setValue("Frequency/LastDecay", last > now ? now : last + halvings * period);
 }
 
 void Model::loadTrie(Trie *t)
@@ -1,14 +1,115 @@
+#pragma once
+#include <QObject>
 #include <QString>
+#include <atomic>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
 #include "../headers/trie.h"
+#include "../headers/journal.h"
 
-class Model
+class QTimer;
+
+class Model : public QObject
 {
+    Q_OBJECT
+
 private:
-    Trie* trie;
+    // Entries parsed by the loader thread, and how far into the file they
+    // reach.
+    struct Batch {
+        std::vector<std::pair<std::string, int>> entries;
+        qint64 position;
+    };
+
+    Trie* trie = nullptr;
+    Journal journal;
+    QString dictionaryFile;
+
+    // State shared with the loader thread of loadAsync().
+    std::thread loader;
+    std::mutex pendingMutex;
+    std::deque<Batch> pending;
+    std::atomic<bool> cancelled{false};
+    std::atomic<bool> loaderDone{false};
+    qint64 bytesTotal = 0;
+    std::string loadError;
+    bool loading = false;
+
+    // Trie edits take Trie::lockForEdit(), since suggestions may be
+    // computed on another thread meanwhile.
+    bool mapSnapshot(const QString &fileName);
+    void insertPending();
+    void finishLoad();
+    void openJournal(const QString &fileName);
+    void replayJournal();
+
+    // State of saveAsync(). The saver thread copies the trie and reads the
+    // journal's size under Trie::lockForRead(), then writes the file and
+    // the snapshot from the copy.
+    std::thread saver;
+    std::atomic<bool> saveOk{false};
+    std::atomic<bool> snapshotSaved{false};
+    std::atomic<bool> saverDone{true};
+    bool saving = false;
+    bool saveQueued = false;
+    // Journal size when the trie was written out; set by the saver.
+    size_t saveMark = 0;
+    // The snapshot no longer matches the dictionary file.
+    bool snapshotStale = false;
+    // discard() has dropped changes that the trie still holds.
+    bool discarded = false;
+    QTimer *autosaveTimer;
+
+    void finishSave();
+
+    // Days over which frequencies halve, 0 for never.
+    int decayDays = 0;
+    void applyDecay();
 
 public:
     Model();
+    ~Model();
     void readJson(const QString &fileName);
+    // Loads a dictionary without blocking the caller. A snapshot is mapped
+    // straight away; otherwise the JSON is parsed on a worker thread and
+    // inserted into the trie batch by batch on this object's thread, so
+    // suggestions come from whatever has been loaded so far.
+    void loadAsync(const QString &fileName);
+    bool isLoading() const { return loading; }
+    // Blocks until a loadAsync() in progress has inserted everything.
+    void waitForLoad();
     void saveJson(const QString &fileName);
+    // Keeps the changes of this session. They are journaled as they
+    // happen, so this only rewrites the dictionary once the journal has
+    // grown large.
+    void save();
+    // Drops the changes of this session from the journal. Meant for
+    // closing: the trie keeps them, so nothing is saved afterwards.
+    void discard();
+    // Writes the dictionary on a worker thread: edits only wait while the
+    // trie is copied, then the copy is written to a temporary file that is
+    // synced and renamed over the dictionary, and snapshotted. A request
+    // while a save is running is coalesced into a single save after it.
+    void saveAsync();
+    bool isSaving() const { return saving; }
+    void waitForSave();
+    // Checks every `minutes` whether to save in the background: once the
+    // journal has grown large, or while there are changes if there is no
+    // journal. 0 turns autosave off.
+    void setAutosaveInterval(int minutes);
+    // Halves every frequency once per `days` that pass, counted across
+    // sessions, so recently used words outrank ones that were popular long
+    // ago. 0 turns decay off.
+    void setDecayHalfLife(int days);
     void loadTrie(Trie *t);
+
+signals:
+    // Percentage of the dictionary file inserted so far.
+    void loadProgress(int percent);
+    void loadFinished(bool ok);
+    void saveFinished(bool ok);
 };
@@ -3,27 +3,34 @@
 #include <QStringList>
 #include <QPushButton>
 #include <QPropertyAnimation>
-#include <QGraphicsOpacityEffect>
 #include <QParallelAnimationGroup>
 #include <QTimer>
 #include "../data_model/model.h"
 
 class InputField;
 class QLabel;
+class SuggestionBar;
+class CompletionWorker;
 
 class AutoCompleteApp : public QMainWindow {
     Q_OBJECT
 
 public:
     explicit AutoCompleteApp(Model *m, QWidget *parent = nullptr);
+    ~AutoCompleteApp() override;
 
 signals:
     void suggestionsVisibilityChanged(bool visible);
+    // Emitted whenever the suggestion bar has been refreshed.
+    void suggestionsUpdated();
+    // Emitted once, after the window has been painted for the first time.
+    void firstPaint();
 
 protected:
     void keyPressEvent(QKeyEvent *event) override;
     void keyReleaseEvent(QKeyEvent *event) override;
     void closeEvent(QCloseEvent *event) override;
+    void paintEvent(QPaintEvent *event) override;
 
 private:
     bool useBFS = true;
@@ -34,29 +41,34 @@ private:
     QTimer *debounceTimer;
     QTimer *throttleTimer;
     bool isThrottling;
+    bool painted = false;
     Model *model;
     InputField *inputField;
-    QWidget *suggestionContainer;
-    QList<QPushButton *> suggestionButtons;
-    int selectedIndex;
+    SuggestionBar *suggestionBar;
     Trie *trie;
+    CompletionWorker *completions;
+    // The word the latest query was submitted for, whose capitalization
+    // the suggestions take on.
+    QString requestedWord;
+    // Generation of the suggestions on the bar. Until it is the worker's
+    // latest, they belong to a prefix the user has changed since, and
+    // activating one would insert the wrong word.
+    uint64_t shownGeneration = 0;
+    bool suggestionsCurrent() const;
     QLabel *titleLabel;
     QPropertyAnimation *slideAnimation;
-    QGraphicsOpacityEffect *opacityEffect;
     QParallelAnimationGroup *currentAnimGroup;
 
     void setupUI();
     void updateInputHeight();
-    QString getCurrentWord();
-    void clearSelection();
     void selectNext();
     void selectPrevious();
-    void updateSelection();
     void activateSelected();
     void updateUI();
     void showSuggestions();
     void hideSuggestions();
     void updateSuggestions();
+    void showCompletions(const std::vector<std::string> &suggestions);
     void replaceCurrentWord(const QString &replacement);
     void loadDictionary(const QString& filename);
     void saveJson();
@@ -64,4 +76,6 @@ private:
 private slots:
     void handleNavigationKeys(QKeyEvent *event);
     void onSettingsChanged(bool bfs, int maxSug, bool useFreq);
+    void onLoadProgress(int percent);
+    void onLoadFinished(bool ok);
 };
@@ -0,0 +1,132 @@
+#pragma once
+#include <cstddef>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// A std::vector that can also stand for an array inside a mapped snapshot.
+// Elements of a mapped column are read and written in place (snapshots are
+// mapped copy-on-write, so writes stay private to the process); the first
+// operation that changes its size copies it into owned storage. A copy of
+// a column is always owned.
+template <typename T>
+class Column {
+    static_assert(std::is_trivially_copyable<T>::value, "columns are stored as raw bytes");
+
+  public:
+    Column() = default;
+    Column(const Column &other) : owned(other.items, other.items + other.count) { sync(); }
+    Column(Column &&other) noexcept
+        : owned(std::move(other.owned)), items(other.items), count(other.count), isMapped(other.isMapped)
+    {
+        other.release();
+    }
+
+    Column &operator=(const Column &other)
+    {
+        if (this != &other) {
+            owned.assign(other.items, other.items + other.count);
+            isMapped = false;
+            sync();
+        }
+        return *this;
+    }
+
+    Column &operator=(Column &&other) noexcept
+    {
+        if (this != &other) {
+            owned = std::move(other.owned);
+            items = other.items;
+            count = other.count;
+            isMapped = other.isMapped;
+            other.release();
+        }
+        return *this;
+    }
+
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    size_t capacity() const { return owned.capacity(); }
+    bool mapped() const { return isMapped; }
+
+    T *data() { return items; }
+    const T *data() const { return items; }
+    T &operator[](size_t index) { return items[index]; }
+    const T &operator[](size_t index) const { return items[index]; }
+    T &back() { return items[count - 1]; }
+    const T &back() const { return items[count - 1]; }
+
+    void push_back(const T &value)
+    {
+        own();
+        owned.push_back(value);
+        sync();
+    }
+
+    template <typename... Args>
+    void emplace_back(Args &&...args)
+    {
+        own();
+        owned.emplace_back(std::forward<Args>(args)...);
+        sync();
+    }
+
+    void pop_back()
+    {
+        own();
+        owned.pop_back();
+        sync();
+    }
+
+    void append(const T *values, size_t n)
+    {
+        own();
+        owned.insert(owned.end(), values, values + n);
+        sync();
+    }
+
+    void reserve(size_t n)
+    {
+        own();
+        owned.reserve(n);
+        sync();
+    }
+
+    // Empties the column and frees its memory.
+    void release()
+    {
+        std::vector<T>().swap(owned);
+        isMapped = false;
+        sync();
+    }
+
+    // Points the column at `n` elements of a mapped snapshot, which must
+    // outlive it or the next release().
+    void map(T *mappedItems, size_t n)
+    {
+        release();
+        items = mappedItems;
+        count = n;
+        isMapped = true;
+    }
+
+  private:
+    std::vector<T> owned;
+    T *items = nullptr;
+    size_t count = 0;
+    bool isMapped = false;
+
+    void own()
+    {
+        if (!isMapped)
+            return;
+        owned.assign(items, items + count);
+        isMapped = false;
+    }
+
+    void sync()
+    {
+        items = owned.data();
+        count = owned.size();
+    }
+};
@@ -0,0 +1,73 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Precomputed top-k completion lists for the shallow nodes of a Trie, i.e.
+// the ones reached by the first few characters of a word. Entries are the
+// indices of word nodes, best first. Lists are filled lazily by the Trie,
+// kept current on insert, and dropped (by bumping a generation counter)
+// whenever a change cannot be applied incrementally.
+class CompletionCache {
+  public:
+    void configure(int depth, int k);
+    int depth() const { return maxDepth; }
+    int size() const { return k; }
+    bool breadthFirst() const { return bfs; }
+
+    const uint32_t *find(uint32_t node, bool bfs, size_t &count) const;
+    void store(uint32_t node, bool bfs, const std::vector<uint32_t> &ranked);
+
+    // Records that `word` (somewhere below `node`) gained frequency.
+    // `before(a, b)` must say whether word node a ranks ahead of b.
+    template <typename Before>
+    void raise(uint32_t node, uint32_t word, Before before);
+
+    void invalidate(uint32_t node);
+    void forget(uint32_t node);
+    void invalidateAll() { ++generation; }
+    void clear();
+    bool empty() const { return slots.empty(); }
+    size_t bytes() const;
+
+  private:
+    // Each block is [generation, count, k entries].
+    std::unordered_map<uint32_t, uint32_t> slots;
+    std::vector<uint32_t> blocks;
+    std::vector<uint32_t> freeBlocks;
+    uint32_t generation = 1;
+    int maxDepth = 3;
+    int k = 10;
+    bool bfs = true;
+
+    static constexpr size_t missing = SIZE_MAX;
+    size_t offset(uint32_t node) const;
+};
+
+template <typename Before>
+void CompletionCache::raise(uint32_t node, uint32_t word, Before before)
+{
+    size_t at = offset(node);
+    if (at == missing)
+        return;
+    uint32_t *b = &blocks[at];
+    uint32_t &count = b[1];
+    uint32_t *entries = b + 2;
+
+    uint32_t i = 0;
+    while (i < count && entries[i] != word)
+        ++i;
+    if (i == count) {
+        if (count < uint32_t(k))
+            ++count;
+        else if (before(word, entries[count - 1]))
+            i = count - 1;
+        else
+            return;
+        entries[i] = word;
+    }
+    for (; i > 0 && before(entries[i], entries[i - 1]); --i)
+        std::swap(entries[i], entries[i - 1]);
+}
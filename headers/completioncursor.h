@@ -0,0 +1,42 @@
+#pragma once
+#include <string>
+#include <vector>
+#include "trie.h"
+
+// Incremental autocomplete state for the word being typed. Each prefix
+// length keeps its trie position and ranked results, so typing a character
+// is one trie step and deleting one reuses the results already computed
+// for the shorter prefix. Results of a prefix whose parent had fewer than
+// max_suggestions completions are derived by filtering the parent's list.
+class CompletionCursor {
+  public:
+    explicit CompletionCursor(Trie *trie);
+
+    const std::vector<std::string> &update(const std::string &prefix, bool bfs, bool usefreq, int max_suggestions);
+    void extend(char c);
+    void retract();
+    void reset();
+
+    const std::string &prefix() const { return text; }
+
+  private:
+    struct Level {
+        Trie::Position at;
+        bool alive;
+        bool ranked;
+        bool complete;
+        std::vector<std::string> words;
+    };
+
+    Trie *trie;
+    std::string text;
+    std::vector<Level> levels;
+    std::vector<std::string> suggestions;
+    uint64_t revision;
+    bool useBFS = false;
+    bool useFreq = false;
+    int maxSuggestions = 0;
+
+    void sync();
+    const std::vector<std::string> &results();
+};
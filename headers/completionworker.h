@@ -0,0 +1,60 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+#include "completioncursor.h"
+#include "trie.h"
+
+// Runs completion queries on a thread of its own, so that an expensive one
+// never holds up the thread handling keystrokes. Every request gets the
+// next generation number. A newer request interrupts the query in flight,
+// which stops at its next check, and only results of the latest generation
+// are passed to `done`, on the worker thread.
+//
+// Other threads may edit the trie meanwhile as long as they hold
+// Trie::lockForEdit(); a query interrupted by an edit runs again after it.
+class CompletionWorker {
+  public:
+    using Callback = std::function<void(uint64_t generation, const std::vector<std::string> &suggestions)>;
+
+    CompletionWorker(Trie *trie, Callback done);
+    CompletionWorker(const CompletionWorker &) = delete;
+    CompletionWorker &operator=(const CompletionWorker &) = delete;
+    ~CompletionWorker();
+
+    // Returns the request's generation.
+    uint64_t submit(const std::string &prefix, bool bfs, bool usefreq, int max_suggestions);
+    // Drops the pending request and the results of the one in flight.
+    void cancel();
+    uint64_t latest() const { return generation; }
+
+  private:
+    struct Request {
+        uint64_t generation;
+        std::string prefix;
+        bool bfs;
+        bool usefreq;
+        int maxSuggestions;
+    };
+
+    Trie *trie;
+    Callback done;
+    // Only used on the worker thread, with the trie locked for queries.
+    CompletionCursor cursor;
+
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::optional<Request> pending;
+    bool stopping = false;
+    std::atomic<uint64_t> generation{0};
+    // Started last, once everything it uses is there.
+    std::thread thread;
+
+    void run();
+};
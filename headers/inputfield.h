@@ -1,18 +1,56 @@
 #pragma once
 #include <QTextEdit>
 #include <QKeyEvent>
+#include <memory>
 
 class InputField : public QTextEdit {
     Q_OBJECT
 public:
     explicit InputField(QWidget *parent = nullptr);
 
+    // The word before the cursor: whitespace right before it is skipped,
+    // and the word runs back to the whitespace before that. Computed from
+    // the characters around the cursor, and only again after the text or
+    // the cursor has moved, so it never costs O(document).
+    const QString &currentWord();
+    bool isEmpty() const;
+    // Whether the text ends with a space.
+    bool endsWithSpace() const;
+
+    // Height of the laid out text. Past largeDocumentChars the heights of
+    // the blocks are cached and only the blocks touched by an edit are
+    // measured again, instead of asking the document for its size, which
+    // lays out all of it.
+    qreal contentHeight();
+    bool isLargeDocument() const { return largeDocument; }
+
+    static constexpr int largeDocumentChars = 64 * 1024;
+
 signals:
     void navigationKeyPressed(QKeyEvent *event);
 
 protected:
     void keyPressEvent(QKeyEvent *event) override;
+    void resizeEvent(QResizeEvent *event) override;
 
 private slots:
     void adjustHeight();
+
+private:
+    QString word;
+    bool wordValid = false;
+
+    // Sum of the heights stored with the blocks; shared with them, since
+    // blocks that are removed take their height off it as they go.
+    std::shared_ptr<qreal> blockHeights;
+    bool largeDocument = false;
+    int measuredWidth = -1;
+    // Characters whose blocks need measuring again, -1 for none.
+    // contentsChange arrives before the layout has seen the edit, so
+    // they are only measured once the height is asked for.
+    int dirtyFrom = -1;
+    int dirtyTo = -1;
+
+    void onContentsChange(int position, int removed, int added);
+    void measureBlocks(int from, int to);
 };
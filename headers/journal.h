@@ -0,0 +1,62 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <string_view>
+
+class Trie;
+
+// Append-only log of the changes made to a Trie since its dictionary was
+// last written out, so that saving costs O(changes) and a crash loses at
+// most the record being written.
+//
+// The file starts with a stamp of the dictionary the records apply to;
+// a journal with any other stamp has already been folded into its
+// dictionary and is ignored. Each record carries a checksum, and a torn or
+// corrupt tail is cut off when the journal is opened. Records appended
+// after open() form the current session, which rollback() drops again.
+class Journal {
+  public:
+    Journal() = default;
+    Journal(const Journal &) = delete;
+    Journal &operator=(const Journal &) = delete;
+    ~Journal();
+
+    bool open(const std::string &fileName, uint64_t base);
+    void close();
+    bool isOpen() const { return file != nullptr; }
+
+    // Applies the records from before this session to `trie`.
+    size_t replay(Trie &trie) const;
+
+    void insert(std::string_view word, int delta);
+    void remove(std::string_view word);
+    void reset();
+    void decay(int halvings);
+
+    bool rollback();
+    // Drops every record, once they are all in the dictionary with stamp
+    // `base`.
+    bool clear(uint64_t base);
+    // Like clear(), but keeps the records from offset `from` on: the ones
+    // made after the dictionary was copied for writing. Records of this
+    // session that are dropped can no longer be rolled back.
+    bool rebase(size_t from, uint64_t base);
+
+    bool empty() const;
+    size_t bytes() const { return size; }
+    size_t sessionBytes() const { return size - sessionStart; }
+
+  private:
+    enum Op : uint8_t { Insert = 1, Remove = 2, Reset = 3, Decay = 4 };
+
+    std::string fileName;
+    std::FILE *file = nullptr;
+    size_t size = 0;
+    size_t sessionStart = 0;
+    std::string record;
+
+    void append(Op op, std::string_view word, int delta);
+    bool truncate(size_t bytes);
+};
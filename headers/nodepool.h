@@ -0,0 +1,137 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include "column.h"
+#include "trienode.h"
+
+// Contiguous storage for the nodes of one Trie. Nodes address each other by
+// 32-bit index, so references into the pool must not be held across
+// allocate() or addChild(). Everything is released at once by clear() or the
+// destructor.
+//
+// Children are kept in per-size blocks in the style of an adaptive radix
+// tree: sorted key arrays for up to 4 and 16 children, a byte index into 48
+// slots, and a direct 256-way table. Nodes move between block kinds as
+// children are added and removed, and iteration is always in key order.
+//
+// Edge labels of a path-compressed Trie live in a single byte arena. Labels
+// are only ever appended; splitting an edge just narrows the ranges.
+//
+// All storage is held in Columns, so a pool can also be mapped straight
+// from a snapshot; forEachColumn() lists them in a fixed order for that.
+class NodePool {
+  public:
+    NodePool();
+
+    uint32_t allocate();
+    void release(uint32_t node);
+    void clear();
+    void reserve(size_t nodes);
+
+    TrieNode& operator[](uint32_t index) { return nodes[index]; }
+    const TrieNode& operator[](uint32_t index) const { return nodes[index]; }
+
+    uint32_t root() const { return 0; }
+    size_t size() const { return nodes.size() - freeNodes.size(); }
+    size_t released() const { return freeNodes.size(); }
+    // Node indices handed out so far, free ones included.
+    size_t slots() const { return nodes.size(); }
+    size_t bytes() const;
+
+    static constexpr size_t maxLabel = UINT16_MAX;
+
+    // Points at labelLength readable bytes even for a node whose label a
+    // damaged snapshot put out of range; those read as zeros.
+    const char *label(uint32_t node) const
+    {
+        const TrieNode &n = nodes[node];
+        return size_t(n.label) + n.labelLength <= labels.size() ? labels.data() + n.label : blank;
+    }
+    void setLabel(uint32_t node, const char *bytes, size_t length);
+
+    uint32_t find(uint32_t node, unsigned char key) const;
+    void addChild(uint32_t node, unsigned char key, uint32_t child);
+    void setChild(uint32_t node, unsigned char key, uint32_t child);
+    void removeChild(uint32_t node, unsigned char key);
+
+    // Checks a pool mapped from a snapshot in full: child blocks, labels
+    // and the free lists must all be in range, and the nodes reachable
+    // from the root must form a tree. Reads every node, so it is for
+    // verified loads; the accessors themselves only bounds-check what they
+    // follow, which keeps a damaged pool from reading out of range but not
+    // from looping.
+    bool wellFormed() const;
+
+    // Steps through the children of `node` in ascending key order. `pos`
+    // starts at 0 and is advanced by each call. Children out of range are
+    // skipped, as find() reports them missing.
+    bool nextChild(uint32_t node, int &pos, unsigned char &key, uint32_t &child) const;
+
+    template <typename F>
+    void forEachChild(uint32_t node, F f) const
+    {
+        int pos = 0;
+        unsigned char key;
+        uint32_t child;
+        while (nextChild(node, pos, key, child))
+            f(key, child);
+    }
+
+    template <typename F>
+    void forEachColumn(F f)
+    {
+        f(nodes);
+        f(freeNodes);
+        f(labels);
+        f(blocks4);
+        f(blocks16);
+        f(blocks48);
+        f(blocks256);
+        for (auto &list : freeBlocks)
+            f(list);
+    }
+
+    template <typename F>
+    void forEachColumn(F f) const
+    {
+        f(nodes);
+        f(freeNodes);
+        f(labels);
+        f(blocks4);
+        f(blocks16);
+        f(blocks48);
+        f(blocks256);
+        for (const auto &list : freeBlocks)
+            f(list);
+    }
+
+  private:
+    struct Children4 { unsigned char keys[4]; uint32_t nodes[4]; };
+    struct Children16 { unsigned char keys[16]; uint32_t nodes[16]; };
+    struct Children48 { unsigned char slots[256]; uint32_t nodes[48]; };
+    struct Children256 { uint32_t nodes[256]; };
+
+    Column<TrieNode> nodes;
+    Column<uint32_t> freeNodes;
+    Column<char> labels;
+    Column<Children4> blocks4;
+    Column<Children16> blocks16;
+    Column<Children48> blocks48;
+    Column<Children256> blocks256;
+    Column<uint32_t> freeBlocks[TrieNode::Node256 + 1];
+
+    // What label() returns for a label out of range.
+    static const char blank[maxLabel];
+
+    static uint16_t capacity(uint8_t kind);
+    uint32_t inRange(uint32_t child) const { return child < nodes.size() ? child : TrieNode::none; }
+
+    template <typename T>
+    uint32_t allocateBlock(Column<T> &blocks, uint8_t kind);
+    size_t blockCount(uint8_t kind) const;
+    // Before an edit: a node whose block is out of range loses its
+    // children, and a count beyond its block's capacity is cut to it.
+    void checkBlock(TrieNode &n);
+    void releaseBlock(uint8_t kind, uint32_t block);
+    void convert(uint32_t node, uint8_t kind);
+};
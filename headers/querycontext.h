@@ -0,0 +1,51 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Scratch space for Trie completion queries: the search frontiers, the
+// top-k heap of word nodes and the path bytes of the nodes being expanded.
+// Buffers keep their capacity between queries, so once a context has grown
+// to what a workload needs, a query through it does no heap allocation.
+// A context serves one query at a time.
+class QueryContext {
+  public:
+    // Sizes the top-k heap for queries of up to k results.
+    explicit QueryContext(size_t k = 16);
+    void reserve(size_t k);
+
+    // Makes queries through this context stop early, with partial results,
+    // once `*counter` no longer holds `seen`. Null turns this off.
+    void stopOnChange(const std::atomic<uint64_t> *counter, uint64_t seen);
+    bool stopped() const { return counter && counter->load(std::memory_order_relaxed) != seen; }
+
+  private:
+    friend class Trie;
+
+    // Best-first frontier entry. `word` entries stand for the node's own
+    // word, the others for its whole subtree. The node's path is stored in
+    // `paths`.
+    struct Candidate {
+        int value;
+        uint32_t node;
+        uint32_t path;
+        uint32_t length;
+        bool word;
+    };
+
+    // Breadth-first frontier entry: a node and the wildcard states live
+    // after its path.
+    struct LevelEntry {
+        uint32_t node;
+        uint64_t states;
+    };
+
+    std::vector<uint32_t> ranked;
+    std::vector<Candidate> frontier;
+    std::vector<std::vector<LevelEntry>> levels;
+    std::string paths;
+    const std::atomic<uint64_t> *counter = nullptr;
+    uint64_t seen = 0;
+};
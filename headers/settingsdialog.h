@@ -7,6 +7,7 @@
 class QComboBox;
 class QSlider;
 class QLabel;
+class QSpinBox;
 
 class SettingsDialog : public QDialog {
     Q_OBJECT
@@ -16,6 +17,8 @@ public:
 
 signals:
     void settingsChanged(bool bfs, int maxSuggestions, bool useFreq);
+    void autosaveChanged(int minutes);
+    void decayChanged(int days);
 
 private slots:
     void onSaveClicked();
@@ -34,5 +37,7 @@ private:
     QSlider *maxSuggestionsSlider;
     QLabel *suggestionCountLabel;
     QCheckBox *freq;
+    QSpinBox *autosaveSpin;
+    QSpinBox *decaySpin;
     QSettings settings;
 };
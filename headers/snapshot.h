@@ -0,0 +1,76 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Binary snapshots of a built Trie, laid out so that the file can be mapped
+// and queried in place instead of parsed.
+//
+// A snapshot is a header, a table of sections and the sections themselves,
+// each aligned to 64 bytes. The header records a format version, the byte
+// order, a caller-chosen source stamp (so a snapshot can be matched with the
+// dictionary it was built from) and checksums of the header and the payload.
+// Opening checks everything but the payload checksum, which would have to
+// read the whole file; pass verify = true to check that as well.
+//
+// Files are mapped copy-on-write: pages are shared between processes until
+// one of them writes, and writes never reach the file. Snapshots are
+// replaced by renaming a new file over the old one, so existing mappings
+// keep seeing the file they opened.
+namespace Snapshot {
+
+enum Flags : uint32_t { Compressed = 1 };
+
+class Writer {
+  public:
+    Writer(uint64_t source, uint64_t words, uint32_t flags);
+
+    // Starts a new section of elements of `elementSize` bytes and adds
+    // bytes to it. Pieces are only referenced until write().
+    void beginSection(size_t elementSize);
+    void add(const void *data, size_t bytes);
+
+    bool write(const std::string &fileName) const;
+
+  private:
+    struct Section {
+        size_t elementSize;
+        size_t bytes;
+        std::vector<std::pair<const char *, size_t>> pieces;
+    };
+
+    uint64_t source;
+    uint64_t words;
+    uint32_t flags;
+    std::vector<Section> sections;
+};
+
+class File {
+  public:
+    File() = default;
+    File(const File &) = delete;
+    File &operator=(const File &) = delete;
+    ~File();
+
+    bool open(const std::string &fileName, uint64_t source, bool verify = false);
+    void close();
+    bool isOpen() const { return base != nullptr; }
+    void swap(File &other);
+
+    uint64_t words() const;
+    uint32_t flags() const;
+    size_t sections() const;
+    char *section(size_t index) const;
+    size_t sectionBytes(size_t index) const;
+    size_t elementSize(size_t index) const;
+
+  private:
+    char *base = nullptr;
+    size_t length = 0;
+
+    bool map(const std::string &fileName);
+    bool valid(uint64_t source, bool verify) const;
+};
+
+}
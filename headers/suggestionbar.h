@@ -0,0 +1,74 @@
+#pragma once
+#include <QFont>
+#include <QStaticText>
+#include <QStringList>
+#include <QVector>
+#include <QWidget>
+
+// The strip of suggestions above the input field, painted in a single
+// paintEvent. The text of each candidate is laid out once into a
+// QStaticText and only again when that candidate changes. Selection and
+// hover are plain indices, so moving them repaints the two items involved
+// and nothing else. Candidates are centered in rows of up to itemsPerRow
+// that wrap to the widget's width.
+class SuggestionBar : public QWidget {
+    Q_OBJECT
+    Q_PROPERTY(qreal opacity READ opacity WRITE setOpacity)
+
+public:
+    explicit SuggestionBar(QWidget *parent = nullptr);
+
+    void setSuggestions(const QStringList &texts);
+    int count() const { return items.size(); }
+    QString text(int index) const { return items[index].text.text(); }
+
+    // -1 for no selection.
+    void setSelectedIndex(int index);
+    int selectedIndex() const { return selected; }
+
+    void setItemsPerRow(int count);
+
+    // Applied while painting, which unlike a QGraphicsOpacityEffect needs
+    // no offscreen pass.
+    void setOpacity(qreal opacity);
+    qreal opacity() const { return alpha; }
+
+    QSize sizeHint() const override;
+    QSize minimumSizeHint() const override;
+    bool hasHeightForWidth() const override { return true; }
+    int heightForWidth(int width) const override;
+
+signals:
+    void activated(int index);
+
+protected:
+    void paintEvent(QPaintEvent *event) override;
+    void mouseMoveEvent(QMouseEvent *event) override;
+    void mousePressEvent(QMouseEvent *event) override;
+    void leaveEvent(QEvent *event) override;
+    void resizeEvent(QResizeEvent *event) override;
+    void changeEvent(QEvent *event) override;
+
+private:
+    struct Item {
+        QStaticText text;
+        int width = 0;
+        QRect rect;
+    };
+
+    QVector<Item> items;
+    QFont itemFont;
+    int perRow = 5;
+    int selected = -1;
+    int hovered = -1;
+    int laidOutHeight = -1;
+    qreal alpha = 1.0;
+
+    void prepare(Item &item);
+    // Places the items for `width`, storing their rects when `rects` is
+    // set, and returns the height they need.
+    int arrange(int width, QVector<QRect> *rects) const;
+    void relayout();
+    int itemAt(const QPoint &pos) const;
+    void repaintItem(int index);
+};
@@ -1,54 +1,207 @@
 #pragma once
+#include <algorithm>
+#include <atomic>
+#include <mutex>
 #include <vector>
+#include <functional>
 #include <string>
-#include <queue>
+#include <string_view>
 #include <../assets/json.hpp>
-#include "trienode.h"
-#include <QRegularExpression>
+#include "nodepool.h"
+#include "wordstore.h"
+#include "completioncache.h"
+#include "wildcard.h"
+#include "querycontext.h"
+#include "snapshot.h"
 
 using json = nlohmann::json;
 
+class Journal;
+
 class Trie {
+public:
+    // Where a prefix ends in the trie: the node whose edge covers its last
+    // byte and how many bytes of that edge's label come after it. Only
+    // valid while revision() is unchanged.
+    struct Position {
+        uint32_t node;
+        uint32_t pending;
+    };
+
 private:
-    TrieNode* root;
+    // Backs the pool and word store after loadSnapshot(); declared first so
+    // that it is unmapped last.
+    Snapshot::File snapshot;
+    NodePool pool;
+    WordStore words;
+    CompletionCache cache;
+    bool compressed;
+    size_t wordCount = 0;
+    uint64_t revisionCount = 0;
+    // Every epoch halves all frequencies, never below 1. Nodes are aged
+    // lazily: frequency and best are stored as of the node's own epoch and
+    // brought up to date when the node is next written. Halving is
+    // monotonic and composes, so best stays the maximum of its subtree
+    // without visiting the subtree.
+    uint16_t epoch = 0;
     std::unordered_map<std::string, int> newWords;
+    Journal* journal = nullptr;
+    // Nodes on the path of the last insert() or remove(), and for remove()
+    // the keys of the edges between them.
+    std::vector<uint32_t> path;
+    std::vector<unsigned char> keys;
+    // Context and result buffer behind the std::string based queries.
+    QueryContext scratch;
+    std::vector<std::string_view> views;
+    // See lockForEdit().
+    std::mutex editMutex;
+    std::atomic<uint64_t> interrupts{0};
 
-    struct Comparator
-    {
-        bool useBFS;
-        bool useFreq;
-        Comparator(bool bfs, bool usefreq) : useBFS(bfs), useFreq(usefreq) {}
-        bool operator()(const std::pair<std::string, int> &a, const std::pair<std::string, int> &b) const {
-            if (useFreq && a.second != b.second)
-                return a.second > b.second;
-
-            if (useBFS) {
-                if (a.first.length() != b.first.length())
-                    return a.first.length() < b.first.length();
-            }
-
-            return a.first < b.first;
-        }
+    // One wildcard query: the compiled pattern, its text for patterns too
+    // long to compile, the ranking to use, how many results to keep and the
+    // context that says when to stop.
+    struct Match {
+        const WildcardPattern& pattern;
+        std::string_view text;
+        bool bfs;
+        bool usefreq;
+        size_t k;
+        const QueryContext& context;
     };
 
-    void collectWords(TrieNode* node, std::string& currentSuffix,
-                      std::priority_queue<std::pair<std::string, int>,
-                                          std::vector<std::pair<std::string, int>>,
-                                          Comparator>& pq,
-                      const std::string& prefix, const std::string& regex, int max_suggestions);
-    void collectJsonEntries(TrieNode *node, std::string &currentWord, json &j);
-    void resetEntries(TrieNode *node, std::string &currentWord);
-    bool isValidRegex(const std::string& word, const std::string& pattern);
-    QString convertToRegex(const QString& pattern);
+    // Enough halvings to bring any frequency down to 1.
+    static constexpr unsigned maxAge = 31;
+    static int aged(int value, unsigned epochs)
+    {
+        return value > 0 && epochs > 0 ? std::max(1, value >> std::min(epochs, maxAge)) : value;
+    }
+    int frequencyOf(uint32_t node) const { return aged(pool[node].frequency, unsigned(epoch - pool[node].epoch)); }
+    int bestOf(uint32_t node) const { return aged(pool[node].best, unsigned(epoch - pool[node].epoch)); }
+    void touch(uint32_t node);
+    void advanceEpoch(unsigned epochs);
+
+    uint32_t descend(std::string_view s, size_t& pending) const;
+    uint32_t splitEdge(uint32_t parent, unsigned char key, uint32_t node, size_t at);
+    void mergeChild(uint32_t parent, unsigned char key, uint32_t node);
+    void appendEdge(std::string& s, unsigned char key, uint32_t node) const;
+    void releaseNode(uint32_t node);
+    void updateBest(uint32_t node);
+    // insert() and assign(); `frequency` is a delta unless `replace`.
+    void add(const std::string& word, int frequency, bool replace);
+    // Suggestion order: higher frequency first (if usefreq), then shorter
+    // words first (if bfs), then alphabetical.
+    bool rankedBefore(uint32_t a, uint32_t b, bool bfs, bool usefreq = true) const;
+    // Expects the path of `node` at the start of context.paths.
+    void topFrequent(QueryContext& context, uint32_t node, bool bfs, size_t k) const;
+    void forEachEntry(uint32_t node, std::string& currentWord,
+                      const std::function<void(std::string_view, int)>& f) const;
+    void collectMatches(uint32_t node, uint64_t states, const Match& match, std::vector<uint32_t>& heap) const;
+    void levelOrder(QueryContext& context, uint32_t start, uint64_t states, const Match& match) const;
+    const uint32_t* rank(QueryContext& context, const Position& at, std::string_view prefix, bool bfs,
+                         bool usefreq, size_t k, size_t& count);
 
 public:
-    Trie();
+    // A compressed Trie stores single-child chains as one node with a
+    // multi-byte edge label instead of one node per character.
+    explicit Trie(bool compressed = false);
+    Trie(const Trie&) = delete;
+    Trie& operator=(const Trie&) = delete;
     bool changed = false;
     bool contain(const std::string& s);
     void addNew(std::string s);
-    void makeJson(json& outJson);
+    void makeJson(json& outJson) const;
+    // Calls f(word, frequency) for every word makeJson() would write, in
+    // the same (byte-wise sorted) order. Removed words and words whose
+    // frequency has dropped to 0 or below are left out.
+    void forEachEntry(const std::function<void(std::string_view word, int frequency)>& f) const;
     void insert(const std::string& word, int frequency = 1);
+    // Sets the frequency of `word` instead of adding to it, the way a
+    // dictionary entry does: a key repeated in a file keeps its last value.
+    void assign(const std::string& word, int frequency);
+    // Sets every frequency to 1. Takes constant time.
     void reset();
+    // Halves every frequency `halvings` times, never below 1, so that
+    // recent use outranks old use. Takes constant time.
+    void decay(unsigned halvings);
+    // Also unlinks the nodes that only led to `word`.
     bool remove(const std::string &word);
+    // Rebuilds the trie densely from its live words, dropping what
+    // remove() and negative insert()s leave behind: freed node slots,
+    // unused edge labels and stale spellings. Invalidates views into the
+    // word store, like clear().
+    void compact();
+    // Replaces the contents of the trie with a copy of `other`'s, in memory
+    // of its own, so that it can be written out while `other` changes. The
+    // copy has no journal and an empty completion cache.
+    void copyFrom(const Trie& other);
+    // Node slots freed by remove() and not reused since.
+    size_t releasedNodes() const;
     std::vector<std::string> autoComplete(const std::string& prefix, bool bfs = false, bool nofreq = false, int max_suggestions = 4);
+    // Allocation-free autoComplete(): writes up to `capacity` suggestions to
+    // `out` and returns how many were written. The views point into the
+    // trie's word store, or into `query` for the typed prefix itself, and
+    // stay valid until the trie is cleared.
+    size_t autoComplete(QueryContext& context, std::string_view query, bool bfs, bool usefreq,
+                        std::string_view* out, size_t capacity);
+    Position rootPosition() const;
+    bool advance(Position& at, char c) const;
+    // Ranked completions of the prefix ending at `at`, without the typed
+    // prefix itself that autoComplete() puts first.
+    void complete(const Position& at, const std::string& prefix, bool bfs, bool usefreq,
+                  int max_suggestions, std::vector<std::string>& out);
+    static void includePrefix(std::vector<std::string>& result, const std::string& prefix, int max_suggestions);
+    uint64_t revision() const { return revisionCount; }
+    // A thread may query the trie while another one edits it if the
+    // querying thread holds lockForQuery() and the editing one holds
+    // lockForEdit() around every change. Taking lockForEdit() interrupts
+    // the query in flight, so edits only wait for it to notice. Reads that
+    // change nothing need no lock.
+    std::unique_lock<std::mutex> lockForEdit();
+    // Also makes the std::string based queries stop when interrupted while
+    // it is held; queryInterrupted() then says whether their results are
+    // cut short. Once it is released they run to the end again.
+    class QueryLock {
+    public:
+        explicit QueryLock(Trie& trie);
+        QueryLock(QueryLock&&) noexcept = default;
+        ~QueryLock();
+
+    private:
+        Trie* trie;
+        std::unique_lock<std::mutex> lock;
+    };
+    QueryLock lockForQuery() { return QueryLock(*this); }
+    // For reading the whole trie on another thread, e.g. to copyFrom() it
+    // for saving. It cannot be interrupted, so edits wait until it is
+    // released.
+    std::unique_lock<std::mutex> lockForRead() { return std::unique_lock<std::mutex>(editMutex); }
+    void interruptQueries() { interrupts.fetch_add(1, std::memory_order_relaxed); }
+    bool queryInterrupted() const { return scratch.stopped(); }
+    // Records every later insert(), remove(), reset() and decay() in `journal`, or
+    // stops recording if it is null.
+    void setJournal(Journal* journal) { this->journal = journal; }
+
+    // Writes the trie as a binary snapshot that loadSnapshot() can map and
+    // query in place. `source` identifies what the trie was built from;
+    // loading fails unless it matches.
+    bool saveSnapshot(const std::string& fileName, uint64_t source) const;
+    // Replaces the contents of the trie with a snapshot, or returns false
+    // and leaves the trie as it was if the file is missing, stale, or was
+    // written for the other kind of trie. Nothing is read up front beyond
+    // the section table; indices are bounds-checked as they are followed,
+    // so a damaged file gives wrong results rather than a crash. `verify`
+    // reads the whole file instead, checking its checksum and that the
+    // nodes form a tree with every index in range.
+    bool loadSnapshot(const std::string& fileName, uint64_t source, bool verify = false);
+
+    void clear();
+    bool isCompressed() const { return compressed; }
+    size_t size() const { return wordCount; }
+    size_t nodeCount() const { return pool.size(); }
+    size_t memoryUsage() const;
+    // Frequency-ranked results for prefixes of up to `depth` bytes are kept
+    // per node, `k` at a time, and served without a traversal.
+    void setCompletionCache(int depth, int k);
+    size_t completionCacheMemory() const { return cache.bytes(); }
+    double bytesPerWord() const;
 };
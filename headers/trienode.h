@@ -1,10 +1,30 @@
 #pragma once
-#include <unordered_map>
+#include <cstdint>
 
 class TrieNode {
   public:
-    std::unordered_map<char, TrieNode*> children;
+    static constexpr uint32_t none = UINT32_MAX;
+
+    // Layout of the child block referenced by `children`, chosen by fan-out.
+    enum Kind : uint8_t { Leaf, Node4, Node16, Node48, Node256 };
+
     int frequency;
+    // Highest frequency of any word in this subtree, the node included.
+    // Never below the true maximum; a value <= 0 means no live words.
+    int best;
+    uint32_t children;
+    // Extra edge bytes after the key that leads here, stored in the pool's
+    // label arena. Always empty unless the Trie is path-compressed.
+    uint32_t label;
+    // Handle of the spelling in the Trie's WordStore once this node has
+    // been a word, WordStore::none before.
+    uint32_t word;
+    uint16_t labelLength;
+    uint16_t count;
+    // Trie epoch that frequency and best are stored as of; the Trie ages
+    // them by the epochs since when they are read.
+    uint16_t epoch;
+    uint8_t kind;
 
     TrieNode();
 };
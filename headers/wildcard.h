@@ -0,0 +1,36 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+// The autocomplete wildcard syntax: '.' matches one character, '*' matches
+// any run of characters and every other byte matches itself. Characters
+// are UTF-8 sequences, so '.' also swallows the continuation bytes of a
+// multi-byte character.
+//
+// Patterns of up to maxLength bytes compile to a bit-parallel NFA that is
+// stepped one byte at a time, which lets a trie traversal abandon a subtree
+// as soon as no state is left. Longer patterns can only be checked against
+// whole words with matches().
+class WildcardPattern {
+  public:
+    static constexpr size_t maxLength = 63;
+
+    explicit WildcardPattern(std::string_view pattern);
+
+    bool compiled() const { return length <= maxLength; }
+    uint64_t start() const { return closure(1); }
+    uint64_t step(uint64_t states, unsigned char byte) const;
+    bool accepts(uint64_t states) const { return states & (uint64_t(1) << length); }
+
+    static bool matches(std::string_view word, std::string_view pattern);
+
+  private:
+    size_t length;
+    uint64_t literals[256];
+    uint64_t dots = 0;
+    uint64_t stars = 0;
+    uint64_t afterDots = 0;
+
+    uint64_t closure(uint64_t states) const;
+};
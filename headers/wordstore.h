@@ -0,0 +1,57 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Append-only storage for the spelling of every word in a Trie. Words are
+// written into fixed-size chunks that never move, so a view returned by
+// get() stays valid until clear(). Handles are 32-bit: chunk << 16 | offset.
+//
+// Chunks can also be mapped from a snapshot, in which case new words go to
+// fresh owned chunks after them. A copy owns all of its chunks and keeps
+// every handle.
+class WordStore {
+  public:
+    static constexpr uint32_t none = UINT32_MAX;
+
+    WordStore() = default;
+    WordStore(const WordStore &other);
+    WordStore(WordStore &&) = default;
+    WordStore &operator=(const WordStore &other);
+    WordStore &operator=(WordStore &&) = default;
+
+    uint32_t add(std::string_view word);
+    // Empty for a handle that does not lead to a word inside the store,
+    // such as one read from a damaged snapshot.
+    std::string_view get(uint32_t handle) const;
+    bool contains(uint32_t handle) const;
+
+    void clear();
+    size_t bytes() const;
+
+    template <typename F>
+    void forEachChunk(F f) const
+    {
+        for (const char *chunk : chunks)
+            f(chunk, chunkBytes(chunk));
+    }
+
+    // Takes over chunks laid out back to back in mapped memory, as written
+    // by forEachChunk(). Returns false if they are not well formed.
+    bool map(const char *data, size_t bytes);
+
+  private:
+    static constexpr size_t chunkSize = size_t(1) << 16;
+    static constexpr size_t header = sizeof(uint32_t);
+
+    static size_t chunkBytes(const char *chunk);
+
+    std::vector<const char *> chunks;
+    std::vector<std::unique_ptr<char[]>> owned;
+    size_t used = chunkSize;
+    size_t oversizedChunks = 0;
+    size_t oversizedBytes = 0;
+};
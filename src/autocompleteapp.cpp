@@ -2,22 +2,32 @@
 #include "settingsdialog.h"
 #include <QMenuBar>
 #include "inputfield.h"
+#include "completionworker.h"
+#include "suggestionbar.h"
 #include <QHBoxLayout>
 #include <QLabel>
-#include <QRegularExpression>
 #include <QStyle>
 #include <QSizePolicy>
 #include <QPropertyAnimation>
 #include <QEasingCurve>
-#include <QGraphicsOpacityEffect>
 #include <QMessageBox>
 #include <QDir>
 #include <math.h>
 using namespace std;
 
+namespace {
+// The search preferences only last for a session. Autosave and decay
+// settings carry over, and so must the decay stamp, or frequencies would
+// never age across sessions.
+void clearSessionSettings(QSettings &settings)
+{
+    settings.remove("Search");
+    settings.remove("Suggestions");
+}
+}
+
 AutoCompleteApp::AutoCompleteApp(Model *m, QWidget *parent)
     : QMainWindow(parent)
-    , selectedIndex(-1)
     , model(m)
     , isBackspace(false)
     , useBFS(true)
@@ -60,14 +70,33 @@ AutoCompleteApp::AutoCompleteApp(Model *m, QWidget *parent)
         setStyleSheet(styleSheet);
         styleFile.close();
     }
-    trie = new Trie;
+    trie = new Trie(true);
+    // Results come back on the worker thread and are shown from the event
+    // loop, unless a newer keystroke has superseded them by then.
+    completions = new CompletionWorker(trie, [this](uint64_t generation, const std::vector<std::string> &suggestions) {
+        QMetaObject::invokeMethod(this, [this, generation, suggestions]() {
+            if (generation == completions->latest()) {
+                shownGeneration = generation;
+                showCompletions(suggestions);
+            }
+        }, Qt::QueuedConnection);
+    });
     model->loadTrie(trie);
 
     setupUI();
+    connect(model, &Model::loadProgress, this, &AutoCompleteApp::onLoadProgress);
+    connect(model, &Model::loadFinished, this, &AutoCompleteApp::onLoadFinished);
+    model->setAutosaveInterval(QSettings().value("Save/AutosaveMinutes", 5).toInt());
+    model->setDecayHalfLife(QSettings().value("Frequency/HalfLifeDays", 0).toInt());
     resize(800, 600);
     setWindowTitle("Fast Writer Pro");
 }
 
+AutoCompleteApp::~AutoCompleteApp()
+{
+    delete completions;
+}
+
 void AutoCompleteApp::keyPressEvent(QKeyEvent *event) {
     if (event->key() == Qt::Key_Backspace || event->key() == Qt::Key_Delete) {
         isBackspace = (event->key() == Qt::Key_Backspace);
@@ -149,32 +178,26 @@ void AutoCompleteApp::setupUI()
     suggestionsSpacer->setVisible(false);
     suggestionsWrapperLayout->addWidget(suggestionsSpacer);
 
-    // Suggestions Container with animation setup
-    suggestionContainer = new QWidget();
-    suggestionContainer->setObjectName("suggestionContainer");
-    suggestionContainer->setSizePolicy(QSizePolicy::Preferred, QSizePolicy::MinimumExpanding);
-
-    QGridLayout* suggestionsLayout = new QGridLayout(suggestionContainer);
-    suggestionsLayout->setContentsMargins(10, 10, 10, 10);
-    suggestionsLayout->setHorizontalSpacing(8);
-    suggestionsLayout->setVerticalSpacing(8);
-    suggestionsLayout->setAlignment(Qt::AlignTop | Qt::AlignHCenter);
-
-    contentLayout->addWidget(suggestionContainer);
+    // Suggestions bar with animation setup
+    suggestionBar = new SuggestionBar();
+    suggestionBar->setObjectName("suggestionContainer");
+    suggestionBar->setSizePolicy(QSizePolicy::Preferred, QSizePolicy::MinimumExpanding);
+    suggestionBar->setOpacity(0.0);
+    connect(suggestionBar, &SuggestionBar::activated, [this](int index) {
+        if (suggestionsCurrent())
+            replaceCurrentWord(suggestionBar->text(index));
+    });
 
-    // Setup opacity effect
-    opacityEffect = new QGraphicsOpacityEffect(suggestionContainer);
-    opacityEffect->setOpacity(0.0);
-    suggestionContainer->setGraphicsEffect(opacityEffect);
+    contentLayout->addWidget(suggestionBar);
 
     // Setup slide animation
-    slideAnimation = new QPropertyAnimation(suggestionContainer, "pos");
+    slideAnimation = new QPropertyAnimation(suggestionBar, "pos");
     slideAnimation->setDuration(150);
 
     // Initialize animation group pointer
     currentAnimGroup = nullptr;
 
-    suggestionsWrapperLayout->addWidget(suggestionContainer);
+    suggestionsWrapperLayout->addWidget(suggestionBar);
 
     inputField = new InputField();
     inputField->setObjectName("inputField");
@@ -183,7 +206,7 @@ void AutoCompleteApp::setupUI()
     contentLayout->addWidget(suggestionsWrapper);
     contentLayout->addWidget(inputField);
 
-    suggestionContainer->hide();
+    suggestionBar->hide();
 
     QHBoxLayout *horizontalWrapper = new QHBoxLayout();
     horizontalWrapper->addStretch();
@@ -210,6 +233,10 @@ void AutoCompleteApp::setupUI()
         SettingsDialog dlg(trie, this);
         connect(&dlg, &SettingsDialog::settingsChanged,
                 this, &AutoCompleteApp::onSettingsChanged);
+        connect(&dlg, &SettingsDialog::autosaveChanged,
+                model, &Model::setAutosaveInterval);
+        connect(&dlg, &SettingsDialog::decayChanged,
+                model, &Model::setDecayHalfLife);
         dlg.exec();
     });
     this->setMenuBar(menuBar);
@@ -223,57 +250,53 @@ void AutoCompleteApp::onSettingsChanged(bool bfs, int maxSug, bool usefreq)
     updateSuggestions();
 }
 
-void AutoCompleteApp::updateInputHeight()
+void AutoCompleteApp::onLoadProgress(int percent)
 {
-    int docHeight = inputField->document()->size().height();
-    inputField->setMinimumHeight(qMin(qMax(60, int(docHeight) + 30), int(this->height() * 0.7)));
+    titleLabel->setText(QString("loading dictionary... %1%").arg(percent));
+    // Suggestions improve as more of the dictionary arrives.
+    if (!inputField->isEmpty() && !isDeletingText)
+        updateSuggestions();
 }
 
-QString AutoCompleteApp::getCurrentWord()
+void AutoCompleteApp::onLoadFinished(bool ok)
 {
-    QTextCursor cursor = inputField->textCursor();
-    QString text = inputField->toPlainText().left(cursor.position());
-    QString trimmed = text.replace(QRegularExpression("\\s+$"), "");
-    QString lastWord = trimmed.section(' ', -1, -1, QString::SectionSkipEmpty);
-    return lastWord;
+    titleLabel->setText(ok ? "let me help you to write fast" : "couldn't load the dictionary");
+    if (!inputField->isEmpty() && !isDeletingText)
+        updateSuggestions();
 }
 
-void AutoCompleteApp::clearSelection()
+void AutoCompleteApp::updateInputHeight()
 {
-    selectedIndex = -1;
-    for(QPushButton *btn : suggestionButtons) {
-        btn->setProperty("selected", false);
-        btn->style()->polish(btn);
-    }
+    int docHeight = inputField->contentHeight();
+    inputField->setMinimumHeight(qMin(qMax(60, int(docHeight) + 30), int(this->height() * 0.7)));
 }
 
 void AutoCompleteApp::selectNext()
 {
-    if(suggestionButtons.isEmpty()) return;
-    selectedIndex = (selectedIndex + 1) % suggestionButtons.size();
-    updateSelection();
+    int count = suggestionBar->count();
+    if(count == 0) return;
+    suggestionBar->setSelectedIndex((suggestionBar->selectedIndex() + 1) % count);
 }
 
 void AutoCompleteApp::selectPrevious()
 {
-    if(suggestionButtons.isEmpty()) return;
-    selectedIndex = (selectedIndex - 1 + suggestionButtons.size()) % suggestionButtons.size();
-    updateSelection();
+    int count = suggestionBar->count();
+    if(count == 0) return;
+    suggestionBar->setSelectedIndex((suggestionBar->selectedIndex() - 1 + count) % count);
 }
 
-void AutoCompleteApp::updateSelection()
+bool AutoCompleteApp::suggestionsCurrent() const
 {
-    for(int i = 0; i < suggestionButtons.size(); i++) {
-        suggestionButtons[i]->setStyleSheet((i == selectedIndex) ?
-                                                "background-color:#e1e1e1; color:rgb(27, 27, 27) ; border-radius: 10px;":
-                                                "background-color:#262626; color: rgba(255, 255, 255, 0.9); border-radius: 10px;");
-    }
+    return shownGeneration == completions->latest();
 }
 
 void AutoCompleteApp::activateSelected()
 {
-    if(selectedIndex >= 0 && selectedIndex < suggestionButtons.size()) {
-        suggestionButtons[selectedIndex]->click();
+    if (!suggestionsCurrent())
+        return;
+    int index = suggestionBar->selectedIndex();
+    if(index >= 0 && index < suggestionBar->count()) {
+        replaceCurrentWord(suggestionBar->text(index));
     }
 }
 
@@ -286,12 +309,12 @@ void AutoCompleteApp::updateUI()
 
 void AutoCompleteApp::showSuggestions()
 {
-    if (!suggestionContainer->isVisible()) {
-        suggestionContainer->show();
+    if (!suggestionBar->isVisible()) {
+        suggestionBar->show();
         emit suggestionsVisibilityChanged(true);
-        opacityEffect->setOpacity(0.0);
+        suggestionBar->setOpacity(0.0);
 
-        QPropertyAnimation *fadeAnimation = new QPropertyAnimation(opacityEffect, "opacity", this);
+        QPropertyAnimation *fadeAnimation = new QPropertyAnimation(suggestionBar, "opacity", this);
         fadeAnimation->setDuration(1000);
         fadeAnimation->setStartValue(0.0);
         fadeAnimation->setEndValue(1.150);
@@ -303,15 +326,15 @@ void AutoCompleteApp::showSuggestions()
 
 void AutoCompleteApp::hideSuggestions()
 {
-    if (suggestionContainer->isVisible()) {
-        QPropertyAnimation *fadeAnimation = new QPropertyAnimation(opacityEffect, "opacity", this);
+    if (suggestionBar->isVisible()) {
+        QPropertyAnimation *fadeAnimation = new QPropertyAnimation(suggestionBar, "opacity", this);
         fadeAnimation->setDuration(200);
-        fadeAnimation->setStartValue(opacityEffect->opacity());
+        fadeAnimation->setStartValue(suggestionBar->opacity());
         fadeAnimation->setEndValue(0.0);
         fadeAnimation->setEasingCurve(QEasingCurve::InCubic);
         
         connect(fadeAnimation, &QPropertyAnimation::finished, [this, fadeAnimation]() {
-            suggestionContainer->hide();
+            suggestionBar->hide();
             emit suggestionsVisibilityChanged(false);
             fadeAnimation->deleteLater();
         });
@@ -320,84 +343,51 @@ void AutoCompleteApp::hideSuggestions()
     }
 }
 
+// Queries run on the completion worker, so a slow one never holds up
+// typing; the bar is refreshed by showCompletions() once the latest one is
+// done.
 void AutoCompleteApp::updateSuggestions()
 {
-    clearSelection();
-    suggestionButtons.clear();
-    QLayoutItem* child;
-    QGridLayout* layout = qobject_cast<QGridLayout*>(suggestionContainer->layout());
-    while ((child = layout->takeAt(0)) != nullptr) {
-        delete child->widget();
-        delete child;
-    }
-
-    if (inputField->toPlainText().endsWith(' ')) {
-        return;
-    }
-    if (inputField->toPlainText().isEmpty()) {
-        hideSuggestions();
+    if (inputField->isEmpty() || inputField->endsWithSpace()) {
+        completions->cancel();
+        shownGeneration = completions->latest();
+        if (inputField->isEmpty())
+            hideSuggestions();
+        showCompletions({});
         return;
     }
+    requestedWord = inputField->currentWord();
+    // The worker's cursor keeps the previous prefix, so typing or deleting
+    // one character only costs one trie step.
+    completions->submit(requestedWord.toLower().toStdString(), useBFS, useFreq, maxSuggestions);
+}
 
-    QString currentWord = getCurrentWord();
-    QString baseWord = currentWord.toLower();
-    bool capitalize = currentWord.length() > 0 && currentWord[0].isUpper();
-    bool allCaps = currentWord == currentWord.toUpper();
-
-    std::vector<std::string> suggestions = trie->autoComplete(
-        baseWord.toStdString(),
-        useBFS,
-        useFreq,
-        maxSuggestions);
-
-    int maxButtonsPerRow = max(5, maxSuggestions/2);
-
-    const int avgButtonWidth = 120;
-
-    int row = 0;
-    int col = 0;
-
+// The bar only lays out again the suggestions that changed, so a refresh
+// that leaves them as they were costs next to nothing.
+void AutoCompleteApp::showCompletions(const std::vector<std::string> &suggestions)
+{
+    bool capitalize = requestedWord.length() > 0 && requestedWord[0].isUpper();
+    bool allCaps = requestedWord == requestedWord.toUpper();
+    QStringList displayTexts;
+    displayTexts.reserve(int(suggestions.size()));
     for (const auto &suggestion : suggestions) {
         QString QSug = QString::fromStdString(suggestion);
-        QString displayText = QSug;
 
         if(capitalize) {
-            displayText = QSug.left(1).toUpper() + QSug.mid(1).toLower();
+            displayTexts.append(QSug.left(1).toUpper() + QSug.mid(1).toLower());
         } else if(allCaps) {
-            displayText = QSug.toUpper();
+            displayTexts.append(QSug.toUpper());
         } else {
-            displayText = QSug.toLower();
-        }
-
-        QPushButton *btn = new QPushButton(displayText);
-        btn->setCursor(Qt::PointingHandCursor);
-        btn->setSizePolicy(QSizePolicy::Preferred, QSizePolicy::Fixed);
-        btn->setMinimumHeight(26);
-
-        QFontMetrics fm(btn->font());
-        int textWidth = fm.horizontalAdvance(displayText);
-        int totalWidth = textWidth + 42;
-        btn->setMinimumWidth(totalWidth);
-
-        connect(btn, &QPushButton::clicked, [this, displayText]() {
-            replaceCurrentWord(displayText);
-        });
-
-        layout->addWidget(btn, row, col);
-        suggestionButtons.append(btn);
-
-        if (++col >= maxButtonsPerRow)
-        {
-            col = 0;
-            row++;
+            displayTexts.append(QSug.toLower());
         }
     }
 
-    if(!suggestionButtons.isEmpty()) {
-        selectedIndex = 0;
-        updateSelection();
+    suggestionBar->setItemsPerRow(max(5, maxSuggestions/2));
+    suggestionBar->setSuggestions(displayTexts);
+    suggestionBar->setSelectedIndex(displayTexts.isEmpty() ? -1 : 0);
+    if (!displayTexts.isEmpty())
         showSuggestions();
-    }
+    emit suggestionsUpdated();
 }
 
 void AutoCompleteApp::replaceCurrentWord(const QString &replacement)
@@ -406,16 +396,18 @@ void AutoCompleteApp::replaceCurrentWord(const QString &replacement)
     cursor.select(QTextCursor::WordUnderCursor);
     cursor.insertText(replacement + " ");
     inputField->setFocus();
+    auto edit = trie->lockForEdit();
     trie->insert(replacement.toLower().toStdString());
 }
 
 void AutoCompleteApp::handleNavigationKeys(QKeyEvent *event)
 {
-    if (suggestionButtons.isEmpty())
+    if (suggestionBar->count() == 0)
     {
-        if (event->key() == Qt::Key_Space && !getCurrentWord().isEmpty())
+        if (event->key() == Qt::Key_Space && !inputField->currentWord().isEmpty())
         {
-            trie->addNew(getCurrentWord().toLower().toStdString());
+            auto edit = trie->lockForEdit();
+            trie->addNew(inputField->currentWord().toLower().toStdString());
             event->accept();
         } else
             event->ignore();
@@ -436,19 +428,32 @@ void AutoCompleteApp::handleNavigationKeys(QKeyEvent *event)
         activateSelected();
         event->accept();
         break;
-    case Qt::Key_Space:
-        trie->addNew(getCurrentWord().toLower().toStdString());
+    case Qt::Key_Space: {
+        auto edit = trie->lockForEdit();
+        trie->addNew(inputField->currentWord().toLower().toStdString());
+        event->ignore();
+        break;
+    }
     default:
         event->ignore();
     }
 }
 
+void AutoCompleteApp::paintEvent(QPaintEvent *event)
+{
+    QMainWindow::paintEvent(event);
+    if (!painted) {
+        painted = true;
+        emit firstPaint();
+    }
+}
+
 void AutoCompleteApp::closeEvent(QCloseEvent *event) {
     // Create a message box with custom buttons
     QSettings settings;
     if (!trie->changed) {
         event->accept();
-        settings.clear();
+        clearSessionSettings(settings);
         return;
     }
 
@@ -467,10 +472,11 @@ void AutoCompleteApp::closeEvent(QCloseEvent *event) {
     if (msgBox.clickedButton() == saveButton) {
         saveJson();
         event->accept();  // Close the window
-        settings.clear();
+        clearSessionSettings(settings);
     } else if (msgBox.clickedButton() == discardButton) {
+        model->discard();
         event->accept();  // Close without saving
-        settings.clear();
+        clearSessionSettings(settings);
     } else if (msgBox.clickedButton() == cancelButton) {
         event->ignore();   // Cancel closing
     }
@@ -478,9 +484,6 @@ void AutoCompleteApp::closeEvent(QCloseEvent *event) {
 
 void AutoCompleteApp::saveJson()
 {
-    QString baseDir = QCoreApplication::applicationDirPath();
-    QString assetPath = QDir(baseDir + "/../../assets").absolutePath();
-
-    QString fileName = assetPath + "/words_dictionary.json";
-    model->saveJson(fileName);
+    // Back to the dictionary it was loaded from.
+    model->save();
 }
@@ -0,0 +1,93 @@
+#include "completioncache.h"
+#include <algorithm>
+
+void CompletionCache::configure(int depth, int size)
+{
+    clear();
+    maxDepth = std::max(depth, 0);
+    k = std::max(size, 1);
+}
+
+size_t CompletionCache::offset(uint32_t node) const
+{
+    auto it = slots.find(node);
+    if (it == slots.end())
+        return missing;
+    size_t at = size_t(it->second) * (k + 2);
+    return blocks[at] == generation ? at : missing;
+}
+
+const uint32_t *CompletionCache::find(uint32_t node, bool mode, size_t &count) const
+{
+    if (mode != bfs)
+        return nullptr;
+    size_t at = offset(node);
+    if (at == missing)
+        return nullptr;
+    count = blocks[at + 1];
+    return &blocks[at + 2];
+}
+
+void CompletionCache::store(uint32_t node, bool mode, const std::vector<uint32_t> &ranked)
+{
+    if (mode != bfs) {
+        bfs = mode;
+        invalidateAll();
+    }
+
+    auto it = slots.find(node);
+    uint32_t slot;
+    if (it != slots.end()) {
+        slot = it->second;
+    } else if (!freeBlocks.empty()) {
+        slot = freeBlocks.back();
+        freeBlocks.pop_back();
+        slots.emplace(node, slot);
+    } else {
+        slot = uint32_t(blocks.size() / (k + 2));
+        blocks.resize(blocks.size() + k + 2);
+        slots.emplace(node, slot);
+    }
+
+    uint32_t *b = &blocks[size_t(slot) * (k + 2)];
+    size_t count = std::min(ranked.size(), size_t(k));
+    b[0] = generation;
+    b[1] = uint32_t(count);
+    std::copy_n(ranked.begin(), count, b + 2);
+}
+
+void CompletionCache::invalidate(uint32_t node)
+{
+    auto it = slots.find(node);
+    if (it != slots.end())
+        blocks[size_t(it->second) * (k + 2)] = 0;
+}
+
+void CompletionCache::forget(uint32_t node)
+{
+    auto it = slots.find(node);
+    if (it == slots.end())
+        return;
+    blocks[size_t(it->second) * (k + 2)] = 0;
+    freeBlocks.push_back(it->second);
+    slots.erase(it);
+}
+
+void CompletionCache::clear()
+{
+    std::unordered_map<uint32_t, uint32_t>().swap(slots);
+    std::vector<uint32_t>().swap(blocks);
+    std::vector<uint32_t>().swap(freeBlocks);
+    ++generation;
+}
+
+size_t CompletionCache::bytes() const
+{
+    // Node-based hash map: one bucket pointer per bucket plus a heap node
+    // holding the pair and a next pointer per element.
+    size_t map = slots.bucket_count() * sizeof(void *)
+                 + slots.size() * (sizeof(std::pair<const uint32_t, uint32_t>) + 2 * sizeof(void *));
+    return sizeof(CompletionCache) + map
+           + blocks.capacity() * sizeof(uint32_t)
+           + freeBlocks.capacity() * sizeof(uint32_t);
+}
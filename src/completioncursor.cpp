@@ -0,0 +1,108 @@
+#include "completioncursor.h"
+#include <algorithm>
+
+CompletionCursor::CompletionCursor(Trie *t) : trie(t)
+{
+    reset();
+}
+
+void CompletionCursor::reset()
+{
+    text.clear();
+    levels.resize(1);
+    levels[0] = {trie->rootPosition(), true, false, false, {}};
+    revision = trie->revision();
+}
+
+void CompletionCursor::sync()
+{
+    if (revision == trie->revision())
+        return;
+    // Positions and results may be stale after an edit; walk the prefix again.
+    std::string typed;
+    typed.swap(text);
+    reset();
+    for (char c : typed)
+        extend(c);
+}
+
+void CompletionCursor::extend(char c)
+{
+    const Level &last = levels.back();
+    Level next{last.at, last.alive, false, false, {}};
+    if (next.alive)
+        next.alive = trie->advance(next.at, c);
+    text.push_back(c);
+    levels.push_back(std::move(next));
+}
+
+void CompletionCursor::retract()
+{
+    if (text.empty())
+        return;
+    text.pop_back();
+    levels.pop_back();
+}
+
+const std::vector<std::string> &CompletionCursor::update(const std::string &prefix, bool bfs, bool usefreq, int max_suggestions)
+{
+    if (prefix.find_first_of(".*") != std::string::npos) {
+        reset();
+        suggestions = trie->autoComplete(prefix, bfs, usefreq, max_suggestions);
+        return suggestions;
+    }
+
+    sync();
+    if (bfs != useBFS || usefreq != useFreq || max_suggestions != maxSuggestions) {
+        useBFS = bfs;
+        useFreq = usefreq;
+        maxSuggestions = max_suggestions;
+        for (Level &level : levels)
+            level.ranked = false;
+    }
+
+    size_t common = 0;
+    while (common < text.size() && common < prefix.size() && text[common] == prefix[common])
+        ++common;
+    while (text.size() > common)
+        retract();
+    while (text.size() < prefix.size())
+        extend(prefix[text.size()]);
+    return results();
+}
+
+const std::vector<std::string> &CompletionCursor::results()
+{
+    suggestions.clear();
+    if (text.empty()) {
+        suggestions.push_back(text);
+        return suggestions;
+    }
+
+    Level &level = levels.back();
+    if (!level.alive)
+        return suggestions;
+
+    if (!level.ranked) {
+        const Level &parent = levels[levels.size() - 2];
+        if (parent.ranked && parent.complete) {
+            level.words.clear();
+            for (const std::string &word : parent.words) {
+                if (word.compare(0, text.size(), text) == 0)
+                    level.words.push_back(word);
+            }
+            level.complete = true;
+        } else {
+            trie->complete(level.at, text, useBFS, useFreq, maxSuggestions, level.words);
+            // Cut short, so not worth keeping; the caller drops the results.
+            if (trie->queryInterrupted())
+                return suggestions;
+            level.complete = level.words.size() < size_t(std::max(maxSuggestions, 0));
+        }
+        level.ranked = true;
+    }
+
+    suggestions = level.words;
+    Trie::includePrefix(suggestions, text, maxSuggestions);
+    return suggestions;
+}
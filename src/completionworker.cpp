@@ -0,0 +1,75 @@
+#include "completionworker.h"
+
+CompletionWorker::CompletionWorker(Trie *t, Callback callback)
+    : trie(t), done(std::move(callback)), cursor(t), thread([this]() { run(); })
+{
+}
+
+CompletionWorker::~CompletionWorker()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+        pending.reset();
+    }
+    trie->interruptQueries();
+    wake.notify_one();
+    thread.join();
+}
+
+uint64_t CompletionWorker::submit(const std::string &prefix, bool bfs, bool usefreq, int max_suggestions)
+{
+    uint64_t current;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        current = ++generation;
+        pending = Request{current, prefix, bfs, usefreq, max_suggestions};
+    }
+    trie->interruptQueries();
+    wake.notify_one();
+    return current;
+}
+
+void CompletionWorker::cancel()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        ++generation;
+        pending.reset();
+    }
+    trie->interruptQueries();
+}
+
+void CompletionWorker::run()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        wake.wait(lock, [this]() { return stopping || pending; });
+        if (stopping)
+            return;
+        Request request = std::move(*pending);
+        pending.reset();
+        lock.unlock();
+
+        bool finished;
+        {
+            Trie::QueryLock query = trie->lockForQuery();
+            if (request.generation != generation)
+                finished = true;
+            else {
+                const std::vector<std::string> &suggestions =
+                    cursor.update(request.prefix, request.bfs, request.usefreq, request.maxSuggestions);
+                finished = !trie->queryInterrupted();
+                // Anything newer has interrupted the query by now, so this
+                // either is the latest generation or has been stopped.
+                if (finished && request.generation == generation)
+                    done(request.generation, suggestions);
+            }
+        }
+
+        lock.lock();
+        // Interrupted by an edit rather than by a newer request.
+        if (!finished && !pending && request.generation == generation)
+            pending = std::move(request);
+    }
+}
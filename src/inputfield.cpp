@@ -1,8 +1,33 @@
 #include "inputfield.h"
 #include <QFontMetrics>
+#include <QAbstractTextDocumentLayout>
+#include <QTextBlock>
+#include <QTextCursor>
 #include <QTextDocument>
 
-InputField::InputField(QWidget *parent) : QTextEdit(parent)
+namespace {
+// Height a block had when it was last measured.
+class BlockHeight : public QTextBlockUserData
+{
+public:
+    explicit BlockHeight(std::shared_ptr<qreal> total) : total(std::move(total)) {}
+    ~BlockHeight() override { *total -= height; }
+
+    void set(qreal value)
+    {
+        *total += value - height;
+        height = value;
+    }
+
+private:
+    std::shared_ptr<qreal> total;
+    qreal height = 0;
+};
+}
+
+InputField::InputField(QWidget *parent)
+    : QTextEdit(parent)
+    , blockHeights(std::make_shared<qreal>(0))
 {
     setVerticalScrollBarPolicy(Qt::ScrollBarAlwaysOff);
     setHorizontalScrollBarPolicy(Qt::ScrollBarAlwaysOff);
@@ -17,6 +42,41 @@ InputField::InputField(QWidget *parent) : QTextEdit(parent)
 
     // Connect to text change to handle auto-resize
     connect(this, &QTextEdit::textChanged, this, &InputField::adjustHeight);
+
+    connect(document(), &QTextDocument::contentsChange, this, &InputField::onContentsChange);
+    connect(this, &QTextEdit::cursorPositionChanged, this, [this]() { wordValid = false; });
+}
+
+const QString &InputField::currentWord()
+{
+    if (wordValid)
+        return word;
+    // characterAt() looks the position up in the document's piece table,
+    // which is logarithmic instead of a copy of the text.
+    QTextDocument *doc = document();
+    int end = textCursor().position();
+    while (end > 0 && doc->characterAt(end - 1).isSpace())
+        --end;
+    int start = end;
+    while (start > 0 && !doc->characterAt(start - 1).isSpace())
+        --start;
+    QTextCursor range(doc);
+    range.setPosition(start);
+    range.setPosition(end, QTextCursor::KeepAnchor);
+    word = range.selectedText();
+    wordValid = true;
+    return word;
+}
+
+bool InputField::isEmpty() const
+{
+    return document()->isEmpty();
+}
+
+bool InputField::endsWithSpace() const
+{
+    // The last character is the closing paragraph separator.
+    return document()->characterAt(document()->characterCount() - 2) == QLatin1Char(' ');
 }
 
 void InputField::keyPressEvent(QKeyEvent *event)
@@ -46,10 +106,79 @@ void InputField::keyPressEvent(QKeyEvent *event)
     QTextEdit::keyPressEvent(event);
 }
 
+void InputField::onContentsChange(int position, int removed, int added)
+{
+    wordValid = false;
+    bool large = document()->characterCount() > largeDocumentChars;
+    if (large && !largeDocument) {
+        // Once per switch: every block, then only the edited ones.
+        dirtyFrom = 0;
+        dirtyTo = document()->characterCount();
+        measuredWidth = viewport()->width();
+    } else if (large) {
+        // Joined with what is still pending, whose end moves with the
+        // text after the edit.
+        int end = position + added;
+        if (dirtyFrom >= 0) {
+            if (dirtyTo >= position + removed)
+                end = qMax(end, dirtyTo + added - removed);
+            position = qMin(position, dirtyFrom);
+        }
+        dirtyFrom = position;
+        dirtyTo = end;
+    } else {
+        dirtyFrom = dirtyTo = -1;
+    }
+    largeDocument = large;
+}
+
+// Blocks that are removed drop their height from the total themselves, so
+// only the ones still overlapping the range need measuring.
+void InputField::measureBlocks(int from, int to)
+{
+    QAbstractTextDocumentLayout *layout = document()->documentLayout();
+    QTextBlock last = document()->findBlock(to);
+    for (QTextBlock block = document()->findBlock(from); block.isValid(); block = block.next()) {
+        BlockHeight *height = static_cast<BlockHeight *>(block.userData());
+        if (!height) {
+            height = new BlockHeight(blockHeights);
+            block.setUserData(height);
+        }
+        height->set(layout->blockBoundingRect(block).height());
+        if (block == last)
+            break;
+    }
+}
+
+qreal InputField::contentHeight()
+{
+    if (!largeDocument)
+        return document()->size().height();
+    if (dirtyFrom >= 0) {
+        // By now the layout has caught up with the edits, and
+        // blockBoundingRect() only lays out up to the blocks asked for.
+        measureBlocks(dirtyFrom, qMin(dirtyTo, document()->characterCount() - 1));
+        dirtyFrom = dirtyTo = -1;
+    }
+    return *blockHeights + 2 * document()->documentMargin();
+}
+
+void InputField::resizeEvent(QResizeEvent *event)
+{
+    QTextEdit::resizeEvent(event);
+    // Lines wrap differently at another width. Growing taller, which is
+    // what adjustHeight() does while typing, changes nothing.
+    if (largeDocument && viewport()->width() != measuredWidth) {
+        measuredWidth = viewport()->width();
+        dirtyFrom = 0;
+        dirtyTo = document()->characterCount();
+    }
+}
+
 void InputField::adjustHeight()
 {
     // Get the content height
-    int docHeight = document()->size().height();
+    int docHeight = contentHeight();
     QFontMetrics fm(font());
     int contentHeight = docHeight + 30; // Add padding
 
@@ -0,0 +1,228 @@
+#include "journal.h"
+#include "trie.h"
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+
+namespace {
+const char magic[8] = {'F', 'W', 'J', 'O', 'U', 'R', 'N', '1'};
+// Magic and the stamp of the dictionary the records apply to.
+constexpr size_t fileHeader = sizeof(magic) + sizeof(uint64_t);
+// Checksum, word length, delta and operation, followed by the word. The
+// checksum covers everything after it.
+constexpr size_t recordHeader = 4 + 4 + 4 + 1;
+
+uint32_t checksum(const char *data, size_t bytes)
+{
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < bytes; ++i)
+        hash = (hash ^ (unsigned char)data[i]) * 16777619u;
+    return hash;
+}
+
+// Size of the intact record at `offset`, or 0 if there is none.
+size_t recordAt(const std::string &data, size_t offset)
+{
+    if (data.size() - offset < recordHeader)
+        return 0;
+    uint32_t sum, length;
+    std::memcpy(&sum, data.data() + offset, 4);
+    std::memcpy(&length, data.data() + offset + 4, 4);
+    if (length > data.size() - offset - recordHeader)
+        return 0;
+    if (checksum(data.data() + offset + 4, recordHeader - 4 + length) != sum)
+        return 0;
+    return recordHeader + length;
+}
+
+std::string readFile(const std::string &fileName)
+{
+    std::ifstream in(fileName, std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+}
+
+Journal::~Journal()
+{
+    close();
+}
+
+bool Journal::open(const std::string &fileName, uint64_t base)
+{
+    close();
+    this->fileName = fileName;
+    std::string data = readFile(fileName);
+    uint64_t stamp = 0;
+    if (data.size() >= fileHeader)
+        std::memcpy(&stamp, data.data() + sizeof(magic), sizeof(stamp));
+    if (data.size() < fileHeader || std::memcmp(data.data(), magic, sizeof(magic)) != 0 || stamp != base)
+        return clear(base);
+
+    size_t valid = fileHeader;
+    while (size_t length = recordAt(data, valid))
+        valid += length;
+    if (!truncate(valid))
+        return false;
+    sessionStart = size;
+    return true;
+}
+
+void Journal::close()
+{
+    if (file)
+        std::fclose(file);
+    file = nullptr;
+    size = 0;
+    sessionStart = 0;
+}
+
+size_t Journal::replay(Trie &trie) const
+{
+    std::string data = readFile(fileName);
+    data.resize(std::min(data.size(), sessionStart));
+    size_t count = 0;
+    size_t offset = fileHeader;
+    while (size_t length = recordAt(data, offset)) {
+        int delta;
+        std::memcpy(&delta, data.data() + offset + 8, 4);
+        std::string word = data.substr(offset + recordHeader, length - recordHeader);
+        switch (Op(data[offset + 12])) {
+        case Insert:
+            trie.insert(word, delta);
+            break;
+        case Remove:
+            trie.remove(word);
+            break;
+        case Reset:
+            trie.reset();
+            break;
+        case Decay:
+            trie.decay(unsigned(std::max(delta, 0)));
+            break;
+        }
+        offset += length;
+        ++count;
+    }
+    return count;
+}
+
+void Journal::insert(std::string_view word, int delta)
+{
+    append(Insert, word, delta);
+}
+
+void Journal::remove(std::string_view word)
+{
+    append(Remove, word, 0);
+}
+
+void Journal::reset()
+{
+    append(Reset, std::string_view(), 0);
+}
+
+void Journal::decay(int halvings)
+{
+    append(Decay, std::string_view(), halvings);
+}
+
+void Journal::append(Op op, std::string_view word, int delta)
+{
+    if (!file)
+        return;
+    record.resize(recordHeader + word.size());
+    uint32_t length = uint32_t(word.size());
+    std::memcpy(&record[4], &length, 4);
+    std::memcpy(&record[8], &delta, 4);
+    record[12] = char(op);
+    std::memcpy(&record[recordHeader], word.data(), word.size());
+    uint32_t sum = checksum(record.data() + 4, record.size() - 4);
+    std::memcpy(&record[0], &sum, 4);
+    // Flushed at once: a record still in our buffer would die with us.
+    if (std::fwrite(record.data(), 1, record.size(), file) == record.size() && std::fflush(file) == 0)
+        size += record.size();
+    else
+        truncate(size);
+}
+
+bool Journal::rollback()
+{
+    return truncate(sessionStart);
+}
+
+bool Journal::clear(uint64_t base)
+{
+    if (file)
+        std::fclose(file);
+    size = sessionStart = 0;
+    file = std::fopen(fileName.c_str(), "wb");
+    if (!file)
+        return false;
+    char header[fileHeader];
+    std::memcpy(header, magic, sizeof(magic));
+    std::memcpy(header + sizeof(magic), &base, sizeof(base));
+    if (std::fwrite(header, 1, fileHeader, file) != fileHeader || std::fflush(file) != 0) {
+        std::fclose(file);
+        file = nullptr;
+        return false;
+    }
+    size = sessionStart = fileHeader;
+    return true;
+}
+
+bool Journal::rebase(size_t from, uint64_t base)
+{
+    std::string data = readFile(fileName);
+    data.resize(std::min(data.size(), size));
+    from = std::max(from, fileHeader);
+    std::string tail = from < data.size() ? data.substr(from) : std::string();
+    size_t session = sessionStart > from ? sessionStart - from : 0;
+
+    // Written next to the journal and renamed over it, so that a crash
+    // leaves either the old journal or the new one.
+    std::string temporary = fileName + ".tmp";
+    std::FILE *out = std::fopen(temporary.c_str(), "wb");
+    if (!out)
+        return false;
+    char header[fileHeader];
+    std::memcpy(header, magic, sizeof(magic));
+    std::memcpy(header + sizeof(magic), &base, sizeof(base));
+    bool ok = std::fwrite(header, 1, fileHeader, out) == fileHeader
+              && std::fwrite(tail.data(), 1, tail.size(), out) == tail.size();
+    ok = std::fclose(out) == 0 && ok;
+    if (file)
+        std::fclose(file);
+    file = nullptr;
+    std::error_code error;
+    if (ok)
+        std::filesystem::rename(temporary, fileName, error);
+    if (!ok || error) {
+        std::remove(temporary.c_str());
+        truncate(size);
+        return false;
+    }
+    file = std::fopen(fileName.c_str(), "ab");
+    size = fileHeader + tail.size();
+    sessionStart = fileHeader + session;
+    return file != nullptr;
+}
+
+bool Journal::empty() const
+{
+    return size <= fileHeader;
+}
+
+bool Journal::truncate(size_t bytes)
+{
+    if (file)
+        std::fclose(file);
+    std::error_code error;
+    std::filesystem::resize_file(fileName, bytes, error);
+    file = error ? nullptr : std::fopen(fileName.c_str(), "ab");
+    if (!file)
+        return false;
+    size = bytes;
+    return true;
+}
@@ -1,22 +1,43 @@
 #include <QApplication>
 #include <QScreen>
 #include <QDir>
+#include <QElapsedTimer>
+#include <QDebug>
 #include "autocompleteapp.h"
 #include <QStyleFactory>
 
 int main(int argc, char *argv[])
 {
+    QElapsedTimer startup;
+    startup.start();
     QApplication app(argc, argv);
     app.setStyle(QStyleFactory::create("Fusion"));
-    Model *model = new Model;
-    AutoCompleteApp window(model);
+    Model model;
+    AutoCompleteApp window(&model);
+
+    // Startup milestones: the window on screen, the first suggestions
+    // available, and the whole dictionary loaded.
+    QObject::connect(&window, &AutoCompleteApp::firstPaint, [&startup]() {
+        qInfo() << "First paint after" << startup.elapsed() << "ms";
+    });
+    bool ready = false;
+    QObject::connect(&model, &Model::loadProgress, [&startup, &ready]() {
+        if (!ready) {
+            ready = true;
+            qInfo() << "First suggestions available after" << startup.elapsed() << "ms";
+        }
+    });
+    QObject::connect(&model, &Model::loadFinished, [&startup]() {
+        qInfo() << "Dictionary loaded after" << startup.elapsed() << "ms";
+    });
+
     QString baseDir = QCoreApplication::applicationDirPath();
     QString assetPath = QDir(baseDir + "/../assets").absolutePath();
     QString assetsPath = QDir(baseDir + "/../../assets").absolutePath();
     if (!QFile::exists(assetPath+"/words_dictionary.json"))
-        model->readJson(assetsPath+"/words_dictionary.json");
+        model.loadAsync(assetsPath+"/words_dictionary.json");
     else
-        model->readJson(assetPath+"/words_dictionary.json");
+        model.loadAsync(assetPath+"/words_dictionary.json");
 
     QScreen *screen = QGuiApplication::primaryScreen();
     int screenWidth = screen->size().width();
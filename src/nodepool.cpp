@@ -0,0 +1,489 @@
+#include "nodepool.h"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+#if defined(__SSE2__) && defined(__GNUC__)
+#include <emmintrin.h>
+#endif
+
+const char NodePool::blank[NodePool::maxLabel] = {};
+
+NodePool::NodePool()
+{
+    clear();
+}
+
+uint32_t NodePool::allocate()
+{
+    while (!freeNodes.empty()) {
+        uint32_t node = freeNodes.back();
+        freeNodes.pop_back();
+        if (node >= nodes.size())
+            continue;
+        nodes[node] = TrieNode();
+        return node;
+    }
+    if (nodes.size() >= TrieNode::none)
+        throw std::length_error("NodePool: 32-bit node index space exhausted");
+    nodes.emplace_back();
+    return uint32_t(nodes.size() - 1);
+}
+
+void NodePool::release(uint32_t node)
+{
+    TrieNode &n = nodes[node];
+    if (n.kind != TrieNode::Leaf && n.children < blockCount(n.kind))
+        releaseBlock(n.kind, n.children);
+    n = TrieNode();
+    freeNodes.push_back(node);
+}
+
+void NodePool::clear()
+{
+    forEachColumn([](auto &column) { column.release(); });
+    nodes.emplace_back();
+    // Keeps label() a valid pointer, for memcmp(), while no label is stored.
+    labels.push_back('\0');
+}
+
+void NodePool::reserve(size_t count)
+{
+    nodes.reserve(count);
+}
+
+size_t NodePool::bytes() const
+{
+    size_t total = sizeof(NodePool)
+                   + nodes.capacity() * sizeof(TrieNode)
+                   + freeNodes.capacity() * sizeof(uint32_t)
+                   + labels.capacity()
+                   + blocks4.capacity() * sizeof(Children4)
+                   + blocks16.capacity() * sizeof(Children16)
+                   + blocks48.capacity() * sizeof(Children48)
+                   + blocks256.capacity() * sizeof(Children256);
+    for (const auto &list : freeBlocks)
+        total += list.capacity() * sizeof(uint32_t);
+    return total;
+}
+
+void NodePool::setLabel(uint32_t node, const char *bytes, size_t length)
+{
+    if (length > maxLabel)
+        throw std::length_error("NodePool: edge label too long");
+    if (labels.size() + length > TrieNode::none)
+        throw std::length_error("NodePool: label arena exhausted");
+    nodes[node].label = uint32_t(labels.size());
+    nodes[node].labelLength = uint16_t(length);
+    labels.append(bytes, length);
+}
+
+uint32_t NodePool::find(uint32_t node, unsigned char key) const
+{
+    const TrieNode &n = nodes[node];
+    switch (n.kind) {
+    case TrieNode::Node4: {
+        if (n.children >= blocks4.size())
+            return TrieNode::none;
+        const Children4 &b = blocks4[n.children];
+        for (int i = 0; i < std::min<int>(n.count, 4); ++i) {
+            if (b.keys[i] == key)
+                return inRange(b.nodes[i]);
+        }
+        return TrieNode::none;
+    }
+    case TrieNode::Node16: {
+        if (n.children >= blocks16.size())
+            return TrieNode::none;
+        const Children16 &b = blocks16[n.children];
+#if defined(__SSE2__) && defined(__GNUC__)
+        __m128i hits = _mm_cmpeq_epi8(_mm_set1_epi8(char(key)),
+                                      _mm_loadu_si128(reinterpret_cast<const __m128i *>(b.keys)));
+        unsigned mask = unsigned(_mm_movemask_epi8(hits)) & ((1u << std::min<int>(n.count, 16)) - 1);
+        return mask ? inRange(b.nodes[__builtin_ctz(mask)]) : TrieNode::none;
+#else
+        for (int i = 0; i < std::min<int>(n.count, 16); ++i) {
+            if (b.keys[i] == key)
+                return inRange(b.nodes[i]);
+        }
+        return TrieNode::none;
+#endif
+    }
+    case TrieNode::Node48: {
+        if (n.children >= blocks48.size())
+            return TrieNode::none;
+        const Children48 &b = blocks48[n.children];
+        unsigned char slot = b.slots[key];
+        return slot && slot <= 48 ? inRange(b.nodes[slot - 1]) : TrieNode::none;
+    }
+    case TrieNode::Node256:
+        if (n.children >= blocks256.size())
+            return TrieNode::none;
+        return inRange(blocks256[n.children].nodes[key]);
+    default:
+        return TrieNode::none;
+    }
+}
+
+void NodePool::addChild(uint32_t node, unsigned char key, uint32_t child)
+{
+    TrieNode &n = nodes[node];
+    checkBlock(n);
+    switch (n.kind) {
+    case TrieNode::Leaf:
+        n.children = allocateBlock(blocks4, TrieNode::Node4);
+        n.kind = TrieNode::Node4;
+        n.count = 0;
+        addChild(node, key, child);
+        return;
+    case TrieNode::Node4:
+    case TrieNode::Node16: {
+        int capacity = n.kind == TrieNode::Node4 ? 4 : 16;
+        if (n.count >= capacity) {
+            convert(node, n.kind + 1);
+            addChild(node, key, child);
+            return;
+        }
+        unsigned char *keys = n.kind == TrieNode::Node4 ? blocks4[n.children].keys : blocks16[n.children].keys;
+        uint32_t *children = n.kind == TrieNode::Node4 ? blocks4[n.children].nodes : blocks16[n.children].nodes;
+        int i = n.count;
+        while (i > 0 && keys[i - 1] > key) {
+            keys[i] = keys[i - 1];
+            children[i] = children[i - 1];
+            --i;
+        }
+        keys[i] = key;
+        children[i] = child;
+        ++n.count;
+        return;
+    }
+    case TrieNode::Node48: {
+        if (n.count >= 48) {
+            convert(node, TrieNode::Node256);
+            addChild(node, key, child);
+            return;
+        }
+        Children48 &b = blocks48[n.children];
+        int slot = 0;
+        while (slot < 47 && b.nodes[slot] != TrieNode::none)
+            ++slot;
+        b.nodes[slot] = child;
+        b.slots[key] = (unsigned char)(slot + 1);
+        ++n.count;
+        return;
+    }
+    case TrieNode::Node256:
+        blocks256[n.children].nodes[key] = child;
+        ++n.count;
+        return;
+    }
+}
+
+void NodePool::setChild(uint32_t node, unsigned char key, uint32_t child)
+{
+    TrieNode &n = nodes[node];
+    checkBlock(n);
+    switch (n.kind) {
+    case TrieNode::Node4:
+    case TrieNode::Node16: {
+        unsigned char *keys = n.kind == TrieNode::Node4 ? blocks4[n.children].keys : blocks16[n.children].keys;
+        uint32_t *children = n.kind == TrieNode::Node4 ? blocks4[n.children].nodes : blocks16[n.children].nodes;
+        for (int i = 0; i < n.count; ++i) {
+            if (keys[i] == key)
+                children[i] = child;
+        }
+        return;
+    }
+    case TrieNode::Node48: {
+        Children48 &b = blocks48[n.children];
+        if (b.slots[key] && b.slots[key] <= 48)
+            b.nodes[b.slots[key] - 1] = child;
+        return;
+    }
+    case TrieNode::Node256:
+        blocks256[n.children].nodes[key] = child;
+        return;
+    default:
+        return;
+    }
+}
+
+void NodePool::removeChild(uint32_t node, unsigned char key)
+{
+    TrieNode &n = nodes[node];
+    checkBlock(n);
+    switch (n.kind) {
+    case TrieNode::Node4:
+    case TrieNode::Node16: {
+        unsigned char *keys = n.kind == TrieNode::Node4 ? blocks4[n.children].keys : blocks16[n.children].keys;
+        uint32_t *children = n.kind == TrieNode::Node4 ? blocks4[n.children].nodes : blocks16[n.children].nodes;
+        int i = 0;
+        while (i < n.count && keys[i] != key)
+            ++i;
+        if (i == n.count)
+            return;
+        for (; i + 1 < n.count; ++i) {
+            keys[i] = keys[i + 1];
+            children[i] = children[i + 1];
+        }
+        --n.count;
+        if (n.count == 0) {
+            releaseBlock(n.kind, n.children);
+            n.kind = TrieNode::Leaf;
+            n.children = TrieNode::none;
+        } else if (n.kind == TrieNode::Node16 && n.count <= 3) {
+            convert(node, TrieNode::Node4);
+        }
+        return;
+    }
+    case TrieNode::Node48: {
+        Children48 &b = blocks48[n.children];
+        if (!b.slots[key] || b.slots[key] > 48)
+            return;
+        b.nodes[b.slots[key] - 1] = TrieNode::none;
+        b.slots[key] = 0;
+        if (--n.count <= 12)
+            convert(node, TrieNode::Node16);
+        return;
+    }
+    case TrieNode::Node256: {
+        Children256 &b = blocks256[n.children];
+        if (b.nodes[key] == TrieNode::none)
+            return;
+        b.nodes[key] = TrieNode::none;
+        if (--n.count <= 40)
+            convert(node, TrieNode::Node48);
+        return;
+    }
+    default:
+        return;
+    }
+}
+
+size_t NodePool::blockCount(uint8_t kind) const
+{
+    switch (kind) {
+    case TrieNode::Node4:
+        return blocks4.size();
+    case TrieNode::Node16:
+        return blocks16.size();
+    case TrieNode::Node48:
+        return blocks48.size();
+    case TrieNode::Node256:
+        return blocks256.size();
+    default:
+        return 0;
+    }
+}
+
+void NodePool::checkBlock(TrieNode &n)
+{
+    if (n.kind == TrieNode::Leaf)
+        return;
+    if (n.children >= blockCount(n.kind)) {
+        n.kind = TrieNode::Leaf;
+        n.children = TrieNode::none;
+        n.count = 0;
+    } else if (n.count > capacity(n.kind)) {
+        n.count = capacity(n.kind);
+    }
+}
+
+uint16_t NodePool::capacity(uint8_t kind)
+{
+    static constexpr uint16_t capacities[] = {0, 4, 16, 48, 256};
+    return capacities[kind];
+}
+
+bool NodePool::wellFormed() const
+{
+    if (nodes.empty() || labels.empty())
+        return false;
+    for (size_t i = 0; i < nodes.size(); ++i) {
+        const TrieNode &n = nodes[i];
+        if (size_t(n.label) + n.labelLength > labels.size())
+            return false;
+        if (n.kind == TrieNode::Leaf)
+            continue;
+        if (n.kind > TrieNode::Node256 || n.children >= blockCount(n.kind))
+            return false;
+        if ((n.kind == TrieNode::Node4 && n.count > 4) || (n.kind == TrieNode::Node16 && n.count > 16))
+            return false;
+        if (n.kind == TrieNode::Node48) {
+            for (unsigned char slot : blocks48[n.children].slots) {
+                if (slot > 48)
+                    return false;
+            }
+        }
+    }
+    for (size_t i = 0; i < freeNodes.size(); ++i) {
+        if (freeNodes[i] >= nodes.size())
+            return false;
+    }
+    for (uint8_t kind = 0; kind <= TrieNode::Node256; ++kind) {
+        const Column<uint32_t> &list = freeBlocks[kind];
+        for (size_t i = 0; i < list.size(); ++i) {
+            if (list[i] >= blockCount(kind))
+                return false;
+        }
+    }
+
+    // Every child reached only once, so traversals end.
+    std::vector<bool> reached(nodes.size());
+    std::vector<uint32_t> pending{root()};
+    reached[root()] = true;
+    while (!pending.empty()) {
+        uint32_t node = pending.back();
+        pending.pop_back();
+        bool ok = true;
+        forEachChild(node, [&](unsigned char, uint32_t child) {
+            if (!ok || reached[child]) {
+                ok = false;
+                return;
+            }
+            reached[child] = true;
+            pending.push_back(child);
+        });
+        if (!ok)
+            return false;
+    }
+    return true;
+}
+
+bool NodePool::nextChild(uint32_t node, int &pos, unsigned char &key, uint32_t &child) const
+{
+    const TrieNode &n = nodes[node];
+    switch (n.kind) {
+    case TrieNode::Node4: {
+        if (n.children >= blocks4.size())
+            return false;
+        const Children4 &b = blocks4[n.children];
+        while (pos < std::min<int>(n.count, 4)) {
+            int i = pos++;
+            if (b.nodes[i] < nodes.size()) {
+                key = b.keys[i];
+                child = b.nodes[i];
+                return true;
+            }
+        }
+        return false;
+    }
+    case TrieNode::Node16: {
+        if (n.children >= blocks16.size())
+            return false;
+        const Children16 &b = blocks16[n.children];
+        while (pos < std::min<int>(n.count, 16)) {
+            int i = pos++;
+            if (b.nodes[i] < nodes.size()) {
+                key = b.keys[i];
+                child = b.nodes[i];
+                return true;
+            }
+        }
+        return false;
+    }
+    case TrieNode::Node48: {
+        if (n.children >= blocks48.size())
+            return false;
+        const Children48 &b = blocks48[n.children];
+        while (pos < 256) {
+            unsigned char slot = b.slots[pos++];
+            if (slot && slot <= 48 && b.nodes[slot - 1] < nodes.size()) {
+                key = (unsigned char)(pos - 1);
+                child = b.nodes[slot - 1];
+                return true;
+            }
+        }
+        return false;
+    }
+    case TrieNode::Node256: {
+        if (n.children >= blocks256.size())
+            return false;
+        const Children256 &b = blocks256[n.children];
+        while (pos < 256) {
+            uint32_t c = b.nodes[pos++];
+            if (c < nodes.size()) {
+                key = (unsigned char)(pos - 1);
+                child = c;
+                return true;
+            }
+        }
+        return false;
+    }
+    default:
+        return false;
+    }
+}
+
+template <typename T>
+uint32_t NodePool::allocateBlock(Column<T> &blocks, uint8_t kind)
+{
+    Column<uint32_t> &list = freeBlocks[kind];
+    while (!list.empty()) {
+        uint32_t block = list.back();
+        list.pop_back();
+        if (block < blocks.size())
+            return block;
+    }
+    blocks.emplace_back();
+    return uint32_t(blocks.size() - 1);
+}
+
+void NodePool::releaseBlock(uint8_t kind, uint32_t block)
+{
+    freeBlocks[kind].push_back(block);
+}
+
+void NodePool::convert(uint32_t node, uint8_t kind)
+{
+    unsigned char keys[256];
+    uint32_t children[256];
+    int count = 0;
+    forEachChild(node, [&](unsigned char key, uint32_t child) {
+        if (count == capacity(kind))
+            return;
+        keys[count] = key;
+        children[count++] = child;
+    });
+
+    TrieNode &n = nodes[node];
+    releaseBlock(n.kind, n.children);
+    n.kind = kind;
+    n.count = uint16_t(count);
+
+    switch (kind) {
+    case TrieNode::Node4: {
+        n.children = allocateBlock(blocks4, kind);
+        Children4 &b = blocks4[n.children];
+        std::copy(keys, keys + count, b.keys);
+        std::copy(children, children + count, b.nodes);
+        break;
+    }
+    case TrieNode::Node16: {
+        n.children = allocateBlock(blocks16, kind);
+        Children16 &b = blocks16[n.children];
+        std::copy(keys, keys + count, b.keys);
+        std::copy(children, children + count, b.nodes);
+        break;
+    }
+    case TrieNode::Node48: {
+        n.children = allocateBlock(blocks48, kind);
+        Children48 &b = blocks48[n.children];
+        std::memset(b.slots, 0, sizeof(b.slots));
+        std::fill(std::begin(b.nodes), std::end(b.nodes), TrieNode::none);
+        for (int i = 0; i < count; ++i) {
+            b.nodes[i] = children[i];
+            b.slots[keys[i]] = (unsigned char)(i + 1);
+        }
+        break;
+    }
+    case TrieNode::Node256: {
+        n.children = allocateBlock(blocks256, kind);
+        Children256 &b = blocks256[n.children];
+        std::fill(std::begin(b.nodes), std::end(b.nodes), TrieNode::none);
+        for (int i = 0; i < count; ++i)
+            b.nodes[keys[i]] = children[i];
+        break;
+    }
+    }
+}
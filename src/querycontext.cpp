@@ -0,0 +1,19 @@
+#include "querycontext.h"
+
+QueryContext::QueryContext(size_t k)
+{
+    reserve(k);
+}
+
+void QueryContext::reserve(size_t k)
+{
+    ranked.reserve(k);
+    frontier.reserve(4 * k);
+    paths.reserve(64 * k);
+}
+
+void QueryContext::stopOnChange(const std::atomic<uint64_t> *counter, uint64_t seen)
+{
+    this->counter = counter;
+    this->seen = seen;
+}
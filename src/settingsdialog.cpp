@@ -2,6 +2,7 @@
 #include <QHBoxLayout>
 #include <QComboBox>
 #include <QSlider>
+#include <QSpinBox>
 #include <QLabel>
 #include <QPushButton>
 #include <QMessageBox>
@@ -35,7 +36,7 @@ void SettingsDialog::setupUI() {
     searchMethodCombo = new QComboBox();
     searchMethodCombo->addItem("DFS (Depth-First Search)", QVariant(false));
     searchMethodCombo->addItem("BFS (Breadth-First Search)", QVariant(true));
-    searchMethodCombo->setToolTip("DFS: Suggests words alphabetically\nBFS: Suggests words by popularity");
+    searchMethodCombo->setToolTip("DFS: Suggests words alphabetically\nBFS: Suggests shorter words first");
     freq = new QCheckBox("Use Frequency Sorting");
     freq->setToolTip("Prioritize suggestions based on word usage frequency");
 
@@ -76,6 +77,28 @@ void SettingsDialog::setupUI() {
 
     mainLayout->insertLayout(3, wordLayout);
 
+    QHBoxLayout *autosaveLayout = new QHBoxLayout();
+    QLabel *autosaveLabel = new QLabel("Autosave Every:");
+    autosaveSpin = new QSpinBox();
+    autosaveSpin->setRange(0, 120);
+    autosaveSpin->setSuffix(" min");
+    autosaveSpin->setSpecialValueText("Off");
+    autosaveSpin->setToolTip("Save the dictionary in the background while it has changes");
+    autosaveLayout->addWidget(autosaveLabel);
+    autosaveLayout->addWidget(autosaveSpin);
+    mainLayout->addLayout(autosaveLayout);
+
+    QHBoxLayout *decayLayout = new QHBoxLayout();
+    QLabel *decayLabel = new QLabel("Halve Frequencies Every:");
+    decaySpin = new QSpinBox();
+    decaySpin->setRange(0, 365);
+    decaySpin->setSuffix(" days");
+    decaySpin->setSpecialValueText("Never");
+    decaySpin->setToolTip("Let recently used words outrank words that were popular long ago");
+    decayLayout->addWidget(decayLabel);
+    decayLayout->addWidget(decaySpin);
+    mainLayout->addLayout(decayLayout);
+
     QHBoxLayout *buttonLayout = new QHBoxLayout();
     QPushButton *saveButton = new QPushButton("Save");
     QPushButton *resetButton = new QPushButton("Reset to Defaults");
@@ -95,20 +118,28 @@ void SettingsDialog::loadSettings() {
     bool useFrequency = settings.value("Search/UseFrequency", true).toBool();
     bool bfs = settings.value("Search/BFS", false).toBool();
     int maxSuggestions = settings.value("Suggestions/Max", 4).toInt();
+    int autosaveMinutes = settings.value("Save/AutosaveMinutes", 5).toInt();
+    int decayDays = settings.value("Frequency/HalfLifeDays", 0).toInt();
 
     freq->setChecked(useFrequency);
     searchMethodCombo->setCurrentIndex(bfs ? 1 : 0);
     maxSuggestionsSlider->setValue(maxSuggestions);
     suggestionCountLabel->setText(QString::number(maxSuggestions));
+    autosaveSpin->setValue(autosaveMinutes);
+    decaySpin->setValue(decayDays);
 }
 
 void SettingsDialog::onSaveClicked() {
     settings.setValue("Search/BFS", searchMethodCombo->currentData().toBool());
     settings.setValue("Suggestions/Max", maxSuggestionsSlider->value());
     settings.setValue("Search/UseFrequency", freq->isChecked());
+    settings.setValue("Save/AutosaveMinutes", autosaveSpin->value());
+    settings.setValue("Frequency/HalfLifeDays", decaySpin->value());
     emit settingsChanged(searchMethodCombo->currentData().toBool(),
                          maxSuggestionsSlider->value(),
                          freq->isChecked());
+    emit autosaveChanged(autosaveSpin->value());
+    emit decayChanged(decaySpin->value());
     accept();
 }
 
@@ -116,6 +147,8 @@ void SettingsDialog::onResetClicked() {
     freq->setChecked(true);
     searchMethodCombo->setCurrentIndex(0);
     maxSuggestionsSlider->setValue(4);
+    autosaveSpin->setValue(5);
+    decaySpin->setValue(0);
 }
 
 void SettingsDialog::onSliderMoved(int value) {
@@ -129,7 +162,10 @@ void SettingsDialog::onAddClicked() {
         return;
     }
 
-    trie->insert(word.toStdString());
+    {
+        auto edit = trie->lockForEdit();
+        trie->insert(word.toStdString());
+    }
     wordInput->clear();
 }
 
@@ -140,7 +176,12 @@ void SettingsDialog::onDeleteClicked() {
         return;
     }
 
-    if(!trie->remove(word.toStdString())) {
+    bool removed;
+    {
+        auto edit = trie->lockForEdit();
+        removed = trie->remove(word.toStdString());
+    }
+    if(!removed) {
         QMessageBox::information(this, "Not Found", "Word not found in dictionary");
     }
     wordInput->clear();
@@ -0,0 +1,319 @@
+#include "snapshot.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <utility>
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace Snapshot {
+
+namespace {
+const char magic[8] = {'F', 'W', 'S', 'N', 'A', 'P', '\r', '\n'};
+constexpr uint32_t version = 2;
+constexpr uint32_t byteOrder = 0x01020304;
+constexpr size_t alignment = 64;
+
+struct Header {
+    char magic[8];
+    uint32_t version;
+    uint32_t byteOrder;
+    uint64_t source;
+    uint64_t words;
+    uint32_t flags;
+    uint32_t sectionCount;
+    uint64_t payloadChecksum;
+    // Of the header, with this field zeroed, and the section table.
+    uint64_t headerChecksum;
+};
+
+struct SectionEntry {
+    uint64_t offset;
+    uint64_t bytes;
+    uint64_t elementSize;
+};
+
+size_t aligned(size_t offset)
+{
+    return (offset + alignment - 1) / alignment * alignment;
+}
+
+// 64-bit FNV-1a over 8-byte words rather than bytes, which is fast enough to
+// run over a whole snapshot. Everything it hashes is padded to a multiple
+// of 8 bytes.
+class Checksum {
+  public:
+    void add(const char *data, size_t bytes)
+    {
+        for (size_t i = 0; i + 8 <= bytes; i += 8) {
+            uint64_t word;
+            std::memcpy(&word, data + i, 8);
+            hash = (hash ^ word) * 0x100000001b3ull;
+        }
+    }
+    uint64_t value() const { return hash; }
+
+  private:
+    uint64_t hash = 0xcbf29ce484222325ull;
+};
+
+uint64_t headerChecksum(Header header, const SectionEntry *entries)
+{
+    header.headerChecksum = 0;
+    Checksum checksum;
+    checksum.add(reinterpret_cast<const char *>(&header), sizeof(header));
+    checksum.add(reinterpret_cast<const char *>(entries), header.sectionCount * sizeof(SectionEntry));
+    return checksum.value();
+}
+
+// Buffers the payload on its way to the file and checksums it block by
+// block. Blocks are a multiple of 8 bytes, and so is the payload as a whole.
+class PayloadWriter {
+  public:
+    explicit PayloadWriter(std::FILE *file) : file(file) {}
+
+    void write(const char *data, size_t bytes)
+    {
+        while (bytes > 0) {
+            size_t n = std::min(bytes, sizeof(buffer) - used);
+            std::memcpy(buffer + used, data, n);
+            used += n;
+            data += n;
+            bytes -= n;
+            if (used == sizeof(buffer))
+                flush();
+        }
+    }
+
+    void pad(size_t bytes)
+    {
+        static const char zeros[alignment] = {};
+        write(zeros, bytes);
+    }
+
+    bool finish(uint64_t &checksum)
+    {
+        flush();
+        checksum = sum.value();
+        return ok;
+    }
+
+  private:
+    std::FILE *file;
+    Checksum sum;
+    char buffer[1 << 16];
+    size_t used = 0;
+    bool ok = true;
+
+    void flush()
+    {
+        sum.add(buffer, used);
+        ok = ok && std::fwrite(buffer, 1, used, file) == used;
+        used = 0;
+    }
+};
+}
+
+Writer::Writer(uint64_t source, uint64_t words, uint32_t flags) : source(source), words(words), flags(flags) {}
+
+void Writer::beginSection(size_t elementSize)
+{
+    sections.push_back({elementSize, 0, {}});
+}
+
+void Writer::add(const void *data, size_t bytes)
+{
+    if (bytes == 0)
+        return;
+    sections.back().pieces.emplace_back(static_cast<const char *>(data), bytes);
+    sections.back().bytes += bytes;
+}
+
+bool Writer::write(const std::string &fileName) const
+{
+    Header header = {};
+    std::memcpy(header.magic, magic, sizeof(magic));
+    header.version = version;
+    header.byteOrder = byteOrder;
+    header.source = source;
+    header.words = words;
+    header.flags = flags;
+    header.sectionCount = uint32_t(sections.size());
+
+    std::vector<SectionEntry> entries(sections.size());
+    size_t offset = aligned(sizeof(Header) + entries.size() * sizeof(SectionEntry));
+    const size_t payload = offset;
+    for (size_t i = 0; i < sections.size(); ++i) {
+        entries[i] = {offset, sections[i].bytes, sections[i].elementSize};
+        offset = aligned(offset + sections[i].bytes);
+    }
+
+    std::string temporary = fileName + ".tmp";
+    std::FILE *file = std::fopen(temporary.c_str(), "wb");
+    if (!file)
+        return false;
+
+    // The header goes in last, once the payload checksum is known.
+    bool ok = std::fseek(file, long(payload), SEEK_SET) == 0;
+    PayloadWriter out(file);
+    for (size_t i = 0; ok && i < sections.size(); ++i) {
+        for (const auto &piece : sections[i].pieces)
+            out.write(piece.first, piece.second);
+        out.pad(aligned(sections[i].bytes) - sections[i].bytes);
+    }
+    ok = out.finish(header.payloadChecksum) && ok;
+    header.headerChecksum = headerChecksum(header, entries.data());
+    ok = ok && std::fseek(file, 0, SEEK_SET) == 0;
+    ok = ok && std::fwrite(&header, sizeof(header), 1, file) == 1;
+    ok = ok && std::fwrite(entries.data(), sizeof(SectionEntry), entries.size(), file) == entries.size();
+    ok = std::fclose(file) == 0 && ok;
+
+#ifdef _WIN32
+    // Fails while another process has the old snapshot mapped; it is then
+    // simply kept until the next save.
+    ok = ok && MoveFileExA(temporary.c_str(), fileName.c_str(), MOVEFILE_REPLACE_EXISTING);
+#else
+    ok = ok && std::rename(temporary.c_str(), fileName.c_str()) == 0;
+#endif
+    if (!ok)
+        std::remove(temporary.c_str());
+    return ok;
+}
+
+File::~File()
+{
+    close();
+}
+
+bool File::open(const std::string &fileName, uint64_t source, bool verify)
+{
+    close();
+    if (!map(fileName))
+        return false;
+    if (!valid(source, verify)) {
+        close();
+        return false;
+    }
+    return true;
+}
+
+bool File::map(const std::string &fileName)
+{
+#ifdef _WIN32
+    HANDLE file = CreateFileA(fileName.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr,
+                              OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+        return false;
+    LARGE_INTEGER size;
+    HANDLE mapping = nullptr;
+    if (GetFileSizeEx(file, &size) && size.QuadPart >= LONGLONG(sizeof(Header)))
+        mapping = CreateFileMappingA(file, nullptr, PAGE_WRITECOPY, 0, 0, nullptr);
+    CloseHandle(file);
+    if (!mapping)
+        return false;
+    // The view keeps the mapping alive on its own.
+    base = static_cast<char *>(MapViewOfFile(mapping, FILE_MAP_COPY, 0, 0, 0));
+    CloseHandle(mapping);
+    length = base ? size_t(size.QuadPart) : 0;
+    return base != nullptr;
+#else
+    int fd = ::open(fileName.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+    struct stat info;
+    void *address = MAP_FAILED;
+    if (fstat(fd, &info) == 0 && info.st_size >= off_t(sizeof(Header)))
+        address = mmap(nullptr, size_t(info.st_size), PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (address == MAP_FAILED)
+        return false;
+    base = static_cast<char *>(address);
+    length = size_t(info.st_size);
+    return true;
+#endif
+}
+
+void File::close()
+{
+    if (!base)
+        return;
+#ifdef _WIN32
+    UnmapViewOfFile(base);
+#else
+    munmap(base, length);
+#endif
+    base = nullptr;
+    length = 0;
+}
+
+void File::swap(File &other)
+{
+    std::swap(base, other.base);
+    std::swap(length, other.length);
+}
+
+bool File::valid(uint64_t source, bool verify) const
+{
+    const Header &header = *reinterpret_cast<const Header *>(base);
+    if (std::memcmp(header.magic, magic, sizeof(magic)) != 0 || header.version != version
+        || header.byteOrder != byteOrder || header.source != source)
+        return false;
+    size_t table = sizeof(Header) + size_t(header.sectionCount) * sizeof(SectionEntry);
+    if (header.sectionCount > (length - sizeof(Header)) / sizeof(SectionEntry)
+        || header.headerChecksum != headerChecksum(header, reinterpret_cast<const SectionEntry *>(base + sizeof(Header))))
+        return false;
+
+    size_t payload = aligned(table);
+    if (payload > length || length % alignment != 0)
+        return false;
+    for (size_t i = 0; i < sections(); ++i) {
+        const SectionEntry &entry = reinterpret_cast<const SectionEntry *>(base + sizeof(Header))[i];
+        if (entry.offset % alignment != 0 || entry.offset < payload || entry.offset > length
+            || entry.bytes > length - entry.offset || entry.elementSize == 0 || entry.bytes % entry.elementSize != 0)
+            return false;
+    }
+    if (!verify)
+        return true;
+    Checksum checksum;
+    checksum.add(base + payload, length - payload);
+    return checksum.value() == header.payloadChecksum;
+}
+
+uint64_t File::words() const
+{
+    return reinterpret_cast<const Header *>(base)->words;
+}
+
+uint32_t File::flags() const
+{
+    return reinterpret_cast<const Header *>(base)->flags;
+}
+
+size_t File::sections() const
+{
+    return reinterpret_cast<const Header *>(base)->sectionCount;
+}
+
+char *File::section(size_t index) const
+{
+    return base + reinterpret_cast<const SectionEntry *>(base + sizeof(Header))[index].offset;
+}
+
+size_t File::sectionBytes(size_t index) const
+{
+    return reinterpret_cast<const SectionEntry *>(base + sizeof(Header))[index].bytes;
+}
+
+size_t File::elementSize(size_t index) const
+{
+    return reinterpret_cast<const SectionEntry *>(base + sizeof(Header))[index].elementSize;
+}
+
+}
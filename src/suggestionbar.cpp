@@ -0,0 +1,239 @@
+#include "suggestionbar.h"
+#include <QFontMetrics>
+#include <QMouseEvent>
+#include <QPaintEvent>
+#include <QPainter>
+#include <QStyle>
+#include <QStyleOption>
+
+namespace {
+const int margin = 10;
+const int spacing = 8;
+const int itemHeight = 34;
+const int itemPadding = 15;
+const int itemRadius = 10;
+const int fontPixels = 14;
+
+const QColor itemColor(0x26, 0x26, 0x26);
+const QColor itemTextColor(255, 255, 255, 230);
+const QColor hoveredColor(0xbc, 0xbc, 0xbc);
+const QColor selectedColor(0xe1, 0xe1, 0xe1);
+const QColor highlightedTextColor(27, 27, 27);
+}
+
+SuggestionBar::SuggestionBar(QWidget *parent)
+    : QWidget(parent)
+{
+    itemFont = font();
+    itemFont.setPixelSize(fontPixels);
+    setMouseTracking(true);
+    setSizePolicy(QSizePolicy::Preferred, QSizePolicy::Preferred);
+}
+
+void SuggestionBar::prepare(Item &item)
+{
+    item.text.setTextFormat(Qt::PlainText);
+    item.text.prepare(QTransform(), itemFont);
+    item.width = QFontMetrics(itemFont).horizontalAdvance(item.text.text()) + 2 * itemPadding;
+}
+
+void SuggestionBar::setSuggestions(const QStringList &texts)
+{
+    bool changed = texts.size() != items.size();
+    items.resize(texts.size());
+    for (int i = 0; i < texts.size(); i++) {
+        if (items[i].text.text() == texts[i] && items[i].width > 0)
+            continue;
+        items[i].text.setText(texts[i]);
+        prepare(items[i]);
+        changed = true;
+    }
+    if (selected >= items.size())
+        selected = -1;
+    if (hovered >= items.size())
+        hovered = -1;
+    if (changed)
+        relayout();
+}
+
+void SuggestionBar::setSelectedIndex(int index)
+{
+    if (index < -1 || index >= items.size() || index == selected)
+        return;
+    int previous = selected;
+    selected = index;
+    repaintItem(previous);
+    repaintItem(selected);
+}
+
+void SuggestionBar::setItemsPerRow(int count)
+{
+    if (count < 1 || count == perRow)
+        return;
+    perRow = count;
+    relayout();
+}
+
+void SuggestionBar::setOpacity(qreal opacity)
+{
+    opacity = qBound(0.0, opacity, 1.0);
+    if (opacity == alpha)
+        return;
+    alpha = opacity;
+    update();
+}
+
+int SuggestionBar::arrange(int width, QVector<QRect> *rects) const
+{
+    int available = width - 2 * margin;
+    int y = margin;
+    int first = 0;
+    while (first < items.size()) {
+        int last = first + 1;
+        int rowWidth = items[first].width;
+        while (last < items.size() && last - first < perRow
+               && rowWidth + spacing + items[last].width <= available) {
+            rowWidth += spacing + items[last].width;
+            ++last;
+        }
+        if (rects) {
+            int x = margin + qMax(0, (available - rowWidth) / 2);
+            for (int i = first; i < last; i++) {
+                (*rects)[i] = QRect(x, y, items[i].width, itemHeight);
+                x += items[i].width + spacing;
+            }
+        }
+        first = last;
+        y += itemHeight + spacing;
+    }
+    if (items.isEmpty())
+        y += itemHeight + spacing;
+    return y - spacing + margin;
+}
+
+void SuggestionBar::relayout()
+{
+    QVector<QRect> rects(items.size());
+    int height = arrange(width(), &rects);
+    for (int i = 0; i < items.size(); i++)
+        items[i].rect = rects[i];
+    if (height != laidOutHeight) {
+        laidOutHeight = height;
+        updateGeometry();
+    }
+    update();
+}
+
+QSize SuggestionBar::sizeHint() const
+{
+    int width = 2 * margin;
+    for (int i = 0; i < items.size() && i < perRow; i++)
+        width += items[i].width + (i > 0 ? spacing : 0);
+    return QSize(width, arrange(width, nullptr));
+}
+
+QSize SuggestionBar::minimumSizeHint() const
+{
+    return QSize(2 * margin, 2 * margin + itemHeight);
+}
+
+int SuggestionBar::heightForWidth(int width) const
+{
+    return arrange(width, nullptr);
+}
+
+int SuggestionBar::itemAt(const QPoint &pos) const
+{
+    for (int i = 0; i < items.size(); i++) {
+        if (items[i].rect.contains(pos))
+            return i;
+    }
+    return -1;
+}
+
+void SuggestionBar::repaintItem(int index)
+{
+    if (index >= 0 && index < items.size())
+        update(items[index].rect);
+}
+
+void SuggestionBar::paintEvent(QPaintEvent *event)
+{
+    QPainter painter(this);
+    painter.setOpacity(alpha);
+
+    // The style sheet background of #suggestionContainer.
+    QStyleOption option;
+    option.initFrom(this);
+    style()->drawPrimitive(QStyle::PE_Widget, &option, &painter, this);
+
+    painter.setRenderHint(QPainter::Antialiasing);
+    painter.setFont(itemFont);
+    int textHeight = QFontMetrics(itemFont).height();
+    for (int i = 0; i < items.size(); i++) {
+        const Item &item = items[i];
+        if (!event->rect().intersects(item.rect))
+            continue;
+        bool highlighted = i == selected || i == hovered;
+        painter.setPen(Qt::NoPen);
+        painter.setBrush(i == selected ? selectedColor : highlighted ? hoveredColor : itemColor);
+        painter.drawRoundedRect(item.rect, itemRadius, itemRadius);
+        painter.setPen(highlighted ? highlightedTextColor : itemTextColor);
+        painter.drawStaticText(item.rect.x() + itemPadding,
+                               item.rect.y() + (item.rect.height() - textHeight) / 2, item.text);
+    }
+}
+
+void SuggestionBar::mouseMoveEvent(QMouseEvent *event)
+{
+    int index = itemAt(event->position().toPoint());
+    if (index != hovered) {
+        int previous = hovered;
+        hovered = index;
+        repaintItem(previous);
+        repaintItem(hovered);
+        if (hovered >= 0)
+            setCursor(Qt::PointingHandCursor);
+        else
+            unsetCursor();
+    }
+    QWidget::mouseMoveEvent(event);
+}
+
+void SuggestionBar::mousePressEvent(QMouseEvent *event)
+{
+    int index = itemAt(event->position().toPoint());
+    if (event->button() == Qt::LeftButton && index >= 0) {
+        emit activated(index);
+        event->accept();
+        return;
+    }
+    QWidget::mousePressEvent(event);
+}
+
+void SuggestionBar::leaveEvent(QEvent *event)
+{
+    int previous = hovered;
+    hovered = -1;
+    repaintItem(previous);
+    unsetCursor();
+    QWidget::leaveEvent(event);
+}
+
+void SuggestionBar::resizeEvent(QResizeEvent *event)
+{
+    relayout();
+    QWidget::resizeEvent(event);
+}
+
+void SuggestionBar::changeEvent(QEvent *event)
+{
+    if (event->type() == QEvent::FontChange) {
+        itemFont = font();
+        itemFont.setPixelSize(fontPixels);
+        for (Item &item : items)
+            prepare(item);
+        relayout();
+    }
+    QWidget::changeEvent(event);
+}
@@ -1,32 +1,209 @@
 #include "trie.h"
-#include <QMessageBox>
+#include "journal.h"
+#include <algorithm>
+#include <cstring>
+#include <thread>
+#include <type_traits>
 
-Trie::Trie() : root(new TrieNode()) {}
+Trie::Trie(bool compressed) : compressed(compressed) {}
+
+uint32_t Trie::descend(std::string_view s, size_t& pending) const
+{
+    uint32_t node = pool.root();
+    size_t i = 0;
+    pending = 0;
+    while (i < s.size()) {
+        node = pool.find(node, (unsigned char)s[i++]);
+        if (node == TrieNode::none)
+            return node;
+        size_t length = pool[node].labelLength;
+        size_t matched = std::min(length, s.size() - i);
+        if (std::memcmp(pool.label(node), s.data() + i, matched) != 0)
+            return TrieNode::none;
+        i += matched;
+        pending = length - matched;
+    }
+    return node;
+}
+
+uint32_t Trie::splitEdge(uint32_t parent, unsigned char key, uint32_t node, size_t at)
+{
+    uint32_t middle = pool.allocate();
+    unsigned char next = (unsigned char)pool.label(node)[at];
+    pool[middle].best = pool[node].best;
+    pool[middle].epoch = pool[node].epoch;
+    pool[middle].label = pool[node].label;
+    pool[middle].labelLength = uint16_t(at);
+    pool[node].label += uint32_t(at + 1);
+    pool[node].labelLength -= uint16_t(at + 1);
+    pool.setChild(parent, key, middle);
+    pool.addChild(middle, next, node);
+    return middle;
+}
+
+void Trie::mergeChild(uint32_t parent, unsigned char key, uint32_t node)
+{
+    int pos = 0;
+    unsigned char childKey;
+    uint32_t child;
+    if (!pool.nextChild(node, pos, childKey, child))
+        return;
+    if (size_t(pool[node].labelLength) + 1 + pool[child].labelLength > NodePool::maxLabel)
+        return;
+
+    std::string merged(pool.label(node), pool[node].labelLength);
+    appendEdge(merged, childKey, child);
+    pool.setLabel(child, merged.data(), merged.size());
+    pool.setChild(parent, key, child);
+    releaseNode(node);
+}
+
+void Trie::appendEdge(std::string& s, unsigned char key, uint32_t node) const
+{
+    s.push_back(char(key));
+    s.append(pool.label(node), pool[node].labelLength);
+}
+
+void Trie::releaseNode(uint32_t node)
+{
+    cache.forget(node);
+    pool.release(node);
+}
+
+void Trie::touch(uint32_t node)
+{
+    TrieNode& n = pool[node];
+    if (n.epoch == epoch)
+        return;
+    unsigned age = unsigned(epoch - n.epoch);
+    n.frequency = aged(n.frequency, age);
+    n.best = aged(n.best, age);
+    n.epoch = epoch;
+}
+
+void Trie::advanceEpoch(unsigned epochs)
+{
+    epochs = std::min(epochs, maxAge);
+    if (epoch + epochs > UINT16_MAX) {
+        // Once every couple of thousand resets: brings every node up to date
+        // so that counting can start over.
+        for (uint32_t node = 0; node < pool.slots(); ++node) {
+            touch(node);
+            pool[node].epoch = 0;
+        }
+        epoch = 0;
+    }
+    epoch = uint16_t(epoch + epochs);
+    cache.invalidateAll();
+    ++revisionCount;
+}
+
+bool Trie::rankedBefore(uint32_t a, uint32_t b, bool bfs, bool usefreq) const
+{
+    if (usefreq) {
+        int first = frequencyOf(a);
+        int second = frequencyOf(b);
+        if (first != second)
+            return first > second;
+    }
+    std::string_view first = words.get(pool[a].word);
+    std::string_view second = words.get(pool[b].word);
+    if (bfs && first.size() != second.size())
+        return first.size() < second.size();
+    return first < second;
+}
+
+void Trie::updateBest(uint32_t node)
+{
+    touch(node);
+    int best = pool[node].frequency;
+    pool.forEachChild(node, [&](unsigned char, uint32_t child) {
+        best = std::max(best, bestOf(child));
+    });
+    pool[node].best = best;
+}
 
 void Trie::insert(const std::string& word, int frequency) {
-    TrieNode* node = root;
-    for (char c : word) {
-        if (!node->children.count(c)) {
-            node->children[c] = new TrieNode();
+    add(word, frequency, false);
+}
+
+void Trie::assign(const std::string& word, int frequency)
+{
+    add(word, frequency, true);
+}
+
+void Trie::add(const std::string& word, int frequency, bool replace)
+{
+    uint32_t node = pool.root();
+    size_t i = 0;
+    path.clear();
+    while (i < word.size()) {
+        path.push_back(node);
+        unsigned char key = (unsigned char)word[i++];
+        uint32_t next = pool.find(node, key);
+        if (next == TrieNode::none) {
+            next = pool.allocate();
+            if (compressed) {
+                size_t length = std::min(word.size() - i, NodePool::maxLabel);
+                pool.setLabel(next, word.data() + i, length);
+                i += length;
+            }
+            pool.addChild(node, key, next);
+            node = next;
+            continue;
         }
-        node = node->children[c];
+
+        size_t length = pool[next].labelLength;
+        const char* label = pool.label(next);
+        size_t matched = 0;
+        while (matched < length && i + matched < word.size() && label[matched] == word[i + matched])
+            ++matched;
+        if (matched < length)
+            next = splitEdge(node, key, next, matched);
+        i += matched;
+        node = next;
     }
     changed = true;
-    if (node->frequency < 0)
-        node->frequency = 0;
-    node->frequency += frequency;
+    ++revisionCount;
+    for (uint32_t ancestor : path)
+        touch(ancestor);
+    touch(node);
+    TrieNode& n = pool[node];
+    if (replace)
+        frequency -= std::max(n.frequency, 0);
+    bool wasWord = n.frequency > 0;
+    if (n.frequency < 0)
+        n.frequency = 0;
+    n.frequency += frequency;
+    if (!wasWord && n.frequency > 0)
+        ++wordCount;
+    else if (wasWord && n.frequency <= 0)
+        --wordCount;
+    if (n.word == WordStore::none)
+        n.word = words.add(word);
+    n.best = std::max(n.best, n.frequency);
+    for (uint32_t ancestor : path)
+        pool[ancestor].best = std::max(pool[ancestor].best, n.frequency);
+    if (journal)
+        journal->insert(word, frequency);
+
+    if (!cache.empty() && frequency != 0) {
+        auto before = [this](uint32_t a, uint32_t b) { return rankedBefore(a, b, cache.breadthFirst()); };
+        path.push_back(node);
+        for (uint32_t ancestor : path) {
+            if (frequency < 0)
+                cache.invalidate(ancestor);
+            else if (n.frequency > 0)
+                cache.raise(ancestor, node, before);
+        }
+    }
 }
 
 bool Trie::contain(const std::string& s)
 {
-    TrieNode* node = root;
-    for (char c : s)
-    {
-        if (!node->children.count(c))
-            return false;
-        node = node->children[c];
-    }
-    return node->frequency > 0;
+    size_t pending;
+    uint32_t node = descend(s, pending);
+    return node != TrieNode::none && pending == 0 && pool[node].frequency > 0;
 }
 
 void Trie::addNew(std::string s)
@@ -45,173 +222,603 @@ void Trie::addNew(std::string s)
         newWords[s] = 1;
 }
 
-std::vector<std::string> Trie::autoComplete(const std::string& regex, bool bfs, bool usefreq, int max_suggestions) {
-    if (regex.empty())
-        return {regex};
-    
-    std::string actualRegex = regex;
-    bool hasRegexChars = false;
-    for (char c : regex) {
-        if (c == '.' || c == '*') {
-            hasRegexChars = true;
-            break;
+Trie::Position Trie::rootPosition() const
+{
+    return {pool.root(), 0};
+}
+
+bool Trie::advance(Position& at, char c) const
+{
+    if (at.pending > 0) {
+        const char* label = pool.label(at.node);
+        if (label[pool[at.node].labelLength - at.pending] != c)
+            return false;
+        --at.pending;
+        return true;
+    }
+    uint32_t next = pool.find(at.node, (unsigned char)c);
+    if (next == TrieNode::none)
+        return false;
+    at.node = next;
+    at.pending = pool[next].labelLength;
+    return true;
+}
+
+// Node handles of the k best completions of the prefix ending at `at`, in
+// suggestion order. Frequency rankings of short prefixes are served by the
+// completion cache, everything else is computed into context.ranked.
+const uint32_t* Trie::rank(QueryContext& context, const Position& at, std::string_view prefix, bool bfs,
+                           bool usefreq, size_t k, size_t& count)
+{
+    std::vector<uint32_t>& ranked = context.ranked;
+    ranked.clear();
+    if (!usefreq) {
+        WildcardPattern everything("*");
+        Match match{everything, prefix, bfs, false, k, context};
+        if (bfs) {
+            levelOrder(context, at.node, everything.start(), match);
+        } else {
+            collectMatches(at.node, everything.start(), match, ranked);
+            std::sort_heap(ranked.begin(), ranked.end(), [&](uint32_t a, uint32_t b) {
+                return rankedBefore(a, b, false, false);
+            });
         }
+        count = ranked.size();
+        return ranked.data();
     }
-    if (!hasRegexChars) {
-        actualRegex += "*";
+
+    const uint32_t* ranking = nullptr;
+    bool cached = prefix.size() <= size_t(cache.depth()) && k <= size_t(cache.size());
+    if (cached)
+        ranking = cache.find(at.node, bfs, count);
+    if (!ranking) {
+        context.paths.assign(prefix.data(), prefix.size());
+        context.paths.append(pool.label(at.node) + pool[at.node].labelLength - at.pending, at.pending);
+        topFrequent(context, at.node, bfs, cached ? size_t(cache.size()) : k);
+        if (cached && !context.stopped()) {
+            cache.store(at.node, bfs, ranked);
+            ranking = cache.find(at.node, bfs, count);
+        } else {
+            ranking = ranked.data();
+            count = ranked.size();
+        }
     }
-    
-    std::string prefix;
-    for (char c : actualRegex) {
-        if (c == '.' || c == '*') break;
-        prefix += c;
+    count = std::min(count, k);
+    return ranking;
+}
+
+void Trie::complete(const Position& at, const std::string& prefix, bool bfs, bool usefreq,
+                    int max_suggestions, std::vector<std::string>& out)
+{
+    out.clear();
+    size_t count;
+    const uint32_t* ranking = rank(scratch, at, prefix, bfs, usefreq, size_t(std::max(max_suggestions, 0)), count);
+    for (size_t i = 0; i < count; ++i)
+        out.emplace_back(words.get(pool[ranking[i]].word));
+}
+
+void Trie::includePrefix(std::vector<std::string>& result, const std::string& prefix, int max_suggestions)
+{
+    if (std::find(result.begin(), result.end(), prefix) != result.end())
+        return;
+    if (!result.empty() && result.size() == size_t(max_suggestions))
+        result.pop_back();
+    result.insert(result.begin(), prefix);
+}
+
+namespace {
+// includePrefix() over a fixed-capacity result array.
+size_t putFirst(std::string_view* out, size_t count, size_t capacity, std::string_view word)
+{
+    if (std::find(out, out + count, word) != out + count)
+        return count;
+    if (count == capacity)
+        --count;
+    std::copy_backward(out, out + count, out + count + 1);
+    out[0] = word;
+    return count + 1;
+}
+}
+
+std::vector<std::string> Trie::autoComplete(const std::string& regex, bool bfs, bool usefreq, int max_suggestions) {
+    views.resize(size_t(std::max(max_suggestions, 1)));
+    size_t count = autoComplete(scratch, regex, bfs, usefreq, views.data(), views.size());
+    return std::vector<std::string>(views.begin(), views.begin() + count);
+}
+
+size_t Trie::autoComplete(QueryContext& context, std::string_view query, bool bfs, bool usefreq,
+                          std::string_view* out, size_t capacity)
+{
+    if (capacity == 0)
+        return 0;
+    if (query.empty()) {
+        out[0] = query;
+        return 1;
     }
-    TrieNode* node = root;
-    for (char c : prefix) {
-        auto it = node->children.find(c);
-        if (it == node->children.end()) return {};
-        node = it->second;
+
+    size_t literal = query.find_first_of(".*");
+    if (literal == std::string_view::npos) {
+        Position at = rootPosition();
+        for (char c : query) {
+            if (!advance(at, c))
+                return 0;
+        }
+        size_t count;
+        const uint32_t* ranking = rank(context, at, query, bfs, usefreq, capacity, count);
+        for (size_t i = 0; i < count; ++i)
+            out[i] = words.get(pool[ranking[i]].word);
+        return putFirst(out, count, capacity, query);
     }
 
-    std::priority_queue<std::pair<std::string, int>,
-                        std::vector<std::pair<std::string, int>>,
-                        Comparator>
-        pq((Comparator(bfs, usefreq)));
-    std::string currentSuffix;
-    collectWords(node, currentSuffix, pq, prefix, actualRegex, max_suggestions);
+    std::string_view prefix = query.substr(0, literal);
+    size_t pending;
+    uint32_t node = descend(prefix, pending);
+    if (node == TrieNode::none)
+        return 0;
 
-    std::vector<std::string> result;
-    while (!pq.empty()) {
-        result.insert(result.begin(), pq.top().first);
-        pq.pop();
+    // The traversal is driven by the pattern itself: each edge byte steps
+    // the matcher, and subtrees that leave it without a live state are
+    // never entered.
+    WildcardPattern pattern(query);
+    uint64_t states = 0;
+    if (pattern.compiled()) {
+        states = pattern.start();
+        for (char c : prefix)
+            states = pattern.step(states, (unsigned char)c);
+        const char* tail = pool.label(node) + pool[node].labelLength - pending;
+        for (size_t i = 0; i < pending && states; ++i)
+            states = pattern.step(states, (unsigned char)tail[i]);
     }
-    
-    bool prefixExists = false;
-    for (const auto& word : result) {
-        if (word == prefix) {
-            prefixExists = true;
-            break;
+    std::vector<uint32_t>& ranked = context.ranked;
+    ranked.clear();
+    Match match{pattern, query, bfs, usefreq, capacity, context};
+    if (!pattern.compiled() || states) {
+        if (bfs && !usefreq) {
+            levelOrder(context, node, states, match);
+        } else {
+            collectMatches(node, states, match, ranked);
+            std::sort_heap(ranked.begin(), ranked.end(), [&](uint32_t a, uint32_t b) {
+                return rankedBefore(a, b, bfs, usefreq);
+            });
         }
     }
-    
-    if (!hasRegexChars) {
-        if (!prefixExists) {
-            if (result.size() == max_suggestions)
-                result.pop_back();
-            result.insert(result.begin(), prefix);
+
+    size_t count = ranked.size();
+    for (size_t i = 0; i < count; ++i)
+        out[i] = words.get(pool[ranked[i]].word);
+    if (query.back() == '*' && WildcardPattern::matches(prefix, query))
+        count = putFirst(out, count, capacity, prefix);
+    return count;
+}
+
+// Emits the nodes of the k best words under `node` in suggestion order by
+// expanding subtrees in order of their best frequency. Ties are broken by
+// the node's path, which is a lower bound for the length and spelling of
+// every word below it, so the first k word entries popped are the answer.
+void Trie::topFrequent(QueryContext& context, uint32_t node, bool bfs, size_t k) const
+{
+    using Candidate = QueryContext::Candidate;
+    std::string& paths = context.paths;
+    std::vector<Candidate>& frontier = context.frontier;
+    std::vector<uint32_t>& out = context.ranked;
+    frontier.clear();
+    out.clear();
+    auto worse = [&](const Candidate& a, const Candidate& b) {
+        if (a.value != b.value)
+            return a.value < b.value;
+        if (bfs && a.length != b.length)
+            return a.length > b.length;
+        int order = paths.compare(a.path, a.length, paths, b.path, b.length);
+        if (order != 0)
+            return order > 0;
+        return a.word && !b.word;
+    };
+
+    if (pool[node].best > 0)
+        frontier.push_back({bestOf(node), node, 0, uint32_t(paths.size()), false});
+    while (!frontier.empty() && out.size() < k && !context.stopped()) {
+        std::pop_heap(frontier.begin(), frontier.end(), worse);
+        Candidate top = frontier.back();
+        frontier.pop_back();
+        if (top.word) {
+            out.push_back(top.node);
+            continue;
         }
+        if (pool[top.node].frequency > 0) {
+            frontier.push_back({frequencyOf(top.node), top.node, top.path, top.length, true});
+            std::push_heap(frontier.begin(), frontier.end(), worse);
+        }
+        pool.forEachChild(top.node, [&](unsigned char key, uint32_t child) {
+            if (pool[child].best <= 0)
+                return;
+            size_t offset = paths.size();
+            paths.resize(offset + top.length);
+            std::copy_n(paths.data() + top.path, top.length, &paths[offset]);
+            appendEdge(paths, key, child);
+            frontier.push_back({bestOf(child), child, uint32_t(offset),
+                                uint32_t(paths.size() - offset), false});
+            std::push_heap(frontier.begin(), frontier.end(), worse);
+        });
     }
+}
 
-    else if (actualRegex.back() == '*') {
-        if (!prefixExists && isValidRegex(prefix, actualRegex)) {
-            if (result.size() == max_suggestions)
-                result.pop_back();
-            result.insert(result.begin(), prefix);
+void Trie::collectMatches(uint32_t node, uint64_t states, const Match& match, std::vector<uint32_t>& heap) const
+{
+    if (match.context.stopped())
+        return;
+    auto before = [&](uint32_t a, uint32_t b) { return rankedBefore(a, b, match.bfs, match.usefreq); };
+    bool accepted = pool[node].frequency > 0
+                    && (match.pattern.compiled()
+                            ? match.pattern.accepts(states)
+                            : WildcardPattern::matches(words.get(pool[node].word), match.text));
+    if (accepted && match.k > 0) {
+        if (heap.size() < match.k) {
+            heap.push_back(node);
+            std::push_heap(heap.begin(), heap.end(), before);
+        } else if (before(node, heap.front())) {
+            std::pop_heap(heap.begin(), heap.end(), before);
+            heap.back() = node;
+            std::push_heap(heap.begin(), heap.end(), before);
         }
     }
-    return result;
+
+    pool.forEachChild(node, [&](unsigned char key, uint32_t child) {
+        if (pool[child].best <= 0)
+            return;
+        if (heap.size() == match.k) {
+            // Children come in alphabetical order, so once k words are found
+            // an alphabetical ranking cannot improve; a frequency ranking can
+            // only improve through a subtree with a higher bound.
+            if (!match.usefreq && !match.bfs)
+                return;
+            if (match.usefreq && bestOf(child) < frequencyOf(heap.front()))
+                return;
+        }
+        uint64_t next = states;
+        if (match.pattern.compiled()) {
+            next = match.pattern.step(next, key);
+            const char* label = pool.label(child);
+            for (size_t i = 0; next && i < pool[child].labelLength; ++i)
+                next = match.pattern.step(next, (unsigned char)label[i]);
+            if (!next)
+                return;
+        }
+        collectMatches(child, next, match, heap);
+    });
 }
 
-void Trie::collectWords(
-    TrieNode* node,
-    std::string& currentSuffix,
-    std::priority_queue<
-        std::pair<std::string, int>,
-        std::vector<std::pair<std::string, int>>,
-        Comparator
-        >& pq,
-    const std::string& prefix,
-    const std::string& regex,
-    int max_suggestions
-    ) {
-    if (node->frequency > 0 && isValidRegex(prefix+currentSuffix, regex)) {
-        pq.emplace(prefix + currentSuffix, node->frequency);
-        if (pq.size() > max_suggestions) pq.pop();
-    }
+// Shortest-first completion: expands the trie one word length at a time and
+// stops after the first length at which k words have been found, since
+// every word still in the frontier is longer. Each length keeps only the
+// alphabetically first words that still fit, so context.ranked never holds
+// more than k entries and comes out in suggestion order.
+void Trie::levelOrder(QueryContext& context, uint32_t start, uint64_t states, const Match& match) const
+{
+    using LevelEntry = QueryContext::LevelEntry;
+    std::vector<std::vector<LevelEntry>>& levels = context.levels;
+    std::vector<uint32_t>& out = context.ranked;
+    out.clear();
+    if (match.k == 0)
+        return;
+    for (auto& level : levels)
+        level.clear();
+    if (levels.empty())
+        levels.resize(1);
+    levels[0].push_back({start, states});
 
-    for (auto& kv : node->children) {
-        currentSuffix.push_back(kv.first);
-        collectWords(kv.second, currentSuffix, pq, prefix, regex, max_suggestions);
-        currentSuffix.pop_back();
+    auto alphabetical = [&](uint32_t a, uint32_t b) {
+        return words.get(pool[a].word) < words.get(pool[b].word);
+    };
+
+    // Checked per entry, since a single level can be most of the trie.
+    // Results cut short are thrown away, so they are left as they are.
+    for (size_t depth = 0; depth < levels.size(); ++depth) {
+        size_t first = out.size();
+        for (const LevelEntry& entry : levels[depth]) {
+            if (context.stopped())
+                return;
+            const TrieNode& n = pool[entry.node];
+            if (n.frequency <= 0)
+                continue;
+            bool accepted = match.pattern.compiled()
+                                ? match.pattern.accepts(entry.states)
+                                : WildcardPattern::matches(words.get(n.word), match.text);
+            if (!accepted)
+                continue;
+            if (out.size() < match.k) {
+                out.push_back(entry.node);
+                std::push_heap(out.begin() + first, out.end(), alphabetical);
+            } else if (alphabetical(entry.node, out[first])) {
+                std::pop_heap(out.begin() + first, out.end(), alphabetical);
+                out.back() = entry.node;
+                std::push_heap(out.begin() + first, out.end(), alphabetical);
+            }
+        }
+        std::sort_heap(out.begin() + first, out.end(), alphabetical);
+        if (out.size() >= match.k)
+            break;
+
+        for (size_t i = 0; i < levels[depth].size(); ++i) {
+            if (context.stopped())
+                return;
+            LevelEntry entry = levels[depth][i];
+            pool.forEachChild(entry.node, [&](unsigned char key, uint32_t child) {
+                if (pool[child].best <= 0)
+                    return;
+                uint64_t next = entry.states;
+                if (match.pattern.compiled()) {
+                    next = match.pattern.step(next, key);
+                    const char* label = pool.label(child);
+                    for (size_t j = 0; next && j < pool[child].labelLength; ++j)
+                        next = match.pattern.step(next, (unsigned char)label[j]);
+                    if (!next)
+                        return;
+                }
+                size_t childDepth = depth + 1 + pool[child].labelLength;
+                if (childDepth >= levels.size())
+                    levels.resize(childDepth + 1);
+                levels[childDepth].push_back({child, next});
+            });
+        }
     }
 }
 
-void Trie::makeJson(json &outJson)
+void Trie::makeJson(json &outJson) const
 {
-    std::string buffer;
-    collectJsonEntries(root, buffer, outJson);
+    forEachEntry([&outJson](std::string_view word, int frequency) { outJson[std::string(word)] = frequency; });
 }
 
-void Trie::collectJsonEntries(TrieNode *node, std::string &currentWord, json& j) {
-    if (node == nullptr) return;
+void Trie::forEachEntry(const std::function<void(std::string_view, int)>& f) const
+{
+    std::string buffer;
+    forEachEntry(pool.root(), buffer, f);
+}
 
-    if (node->frequency >= 0) {
-        j[currentWord] = node->frequency;
-    }
+void Trie::forEachEntry(uint32_t node, std::string& currentWord,
+                        const std::function<void(std::string_view, int)>& f) const
+{
+    if (pool[node].frequency > 0)
+        f(currentWord, frequencyOf(node));
 
-    for (const auto& pair : node->children) {
-        currentWord.push_back(pair.first);
-        collectJsonEntries(pair.second, currentWord, j);
-        currentWord.pop_back();
-    }
+    pool.forEachChild(node, [&](unsigned char key, uint32_t child) {
+        size_t length = currentWord.size();
+        appendEdge(currentWord, key, child);
+        forEachEntry(child, currentWord, f);
+        currentWord.resize(length);
+    });
 }
 
 bool Trie::remove(const std::string& word)
 {
-    TrieNode* node = root;
-    for (char c : word)
+    uint32_t node = pool.root();
+    size_t i = 0;
+    path.clear();
+    keys.clear();
+    while (i < word.size())
     {
-        if (!node->children.count(c))
+        path.push_back(node);
+        unsigned char key = (unsigned char)word[i++];
+        node = pool.find(node, key);
+        if (node == TrieNode::none)
+            return false;
+        size_t length = pool[node].labelLength;
+        size_t matched = std::min(length, word.size() - i);
+        if (std::memcmp(pool.label(node), word.data() + i, matched) != 0)
             return false;
-        node = node->children[c];
+        if (matched < length)
+            return true;
+        keys.push_back(key);
+        i += length;
+    }
+    if (pool[node].frequency > 0)
+        --wordCount;
+    pool[node].frequency = -1;
+    ++revisionCount;
+    path.push_back(node);
+    if (!cache.empty()) {
+        for (uint32_t ancestor : path)
+            cache.invalidate(ancestor);
+    }
+
+    // Unlinks the nodes that no longer lead to any word, from the bottom up.
+    size_t depth = path.size() - 1;
+    while (depth > 0 && pool[path[depth]].frequency <= 0 && pool[path[depth]].kind == TrieNode::Leaf) {
+        pool.removeChild(path[depth - 1], keys[depth - 1]);
+        releaseNode(path[depth]);
+        --depth;
+    }
+    path.resize(depth + 1);
+    for (auto it = path.rbegin(); it != path.rend(); ++it) {
+        int old = bestOf(*it);
+        updateBest(*it);
+        if (pool[*it].best == old)
+            break;
     }
-    node->frequency = 0;
+    // What is left of a chain of single children becomes one edge again.
+    node = path[depth];
+    if (compressed && depth > 0 && pool[node].frequency <= 0 && pool[node].count == 1)
+        mergeChild(path[depth - 1], keys[depth - 1], node);
+    if (journal)
+        journal->remove(word);
     return true;
 }
 
 void Trie::reset()
 {
-    std::string buffer;
-    resetEntries(root, buffer);
+    advanceEpoch(maxAge);
+    if (journal)
+        journal->reset();
 }
 
-void Trie::resetEntries(TrieNode *node, std::string &currentWord)
+void Trie::decay(unsigned halvings)
 {
-    if (node == nullptr)
+    if (halvings == 0)
         return;
+    advanceEpoch(halvings);
+    changed = true;
+    if (journal)
+        journal->decay(int(std::min(halvings, maxAge)));
+}
 
-    if (node->frequency > 0) {
-        node->frequency = 1;
-    }
+void Trie::clear()
+{
+    pool.clear();
+    words.clear();
+    cache.clear();
+    newWords.clear();
+    snapshot.close();
+    wordCount = 0;
+    epoch = 0;
+    changed = true;
+    ++revisionCount;
+}
 
-    for (const auto &pair : node->children) {
-        currentWord.push_back(pair.first);
-        resetEntries(pair.second, currentWord);
-        currentWord.pop_back();
-    }
+void Trie::compact()
+{
+    // Rebuilt in key order, which also puts the nodes of a subtree and the
+    // spellings of neighbouring words next to each other.
+    Trie dense(compressed);
+    std::string buffer;
+    forEachEntry([&](std::string_view word, int frequency) {
+        buffer.assign(word);
+        dense.insert(buffer, frequency);
+    });
+    pool = std::move(dense.pool);
+    words = std::move(dense.words);
+    cache.clear();
+    // Only now that nothing points into it.
+    snapshot.close();
+    wordCount = dense.wordCount;
+    // The dense copy holds the aged frequencies.
+    epoch = 0;
+    ++revisionCount;
 }
 
-QString Trie::convertToRegex(const QString& pattern) {
-    QString regexPattern;
-    for (const QChar& c : pattern) {
-        if (c == '.') {
-            regexPattern += ".";
-        } else if (c == '*') {
-            regexPattern += ".*";
-        } else {
-            regexPattern += QRegularExpression::escape(QString(c));
+void Trie::copyFrom(const Trie& other)
+{
+    clear();
+    pool = other.pool;
+    words = other.words;
+    compressed = other.compressed;
+    wordCount = other.wordCount;
+    epoch = other.epoch;
+    changed = other.changed;
+}
+
+size_t Trie::releasedNodes() const
+{
+    return pool.released();
+}
+
+// Sections are the pool's columns in forEachColumn() order, the word
+// store's chunks, then the trie's epoch. Frequencies are part of the node
+// records.
+bool Trie::saveSnapshot(const std::string& fileName, uint64_t source) const
+{
+    Snapshot::Writer writer(source, wordCount, compressed ? uint32_t(Snapshot::Compressed) : 0u);
+    pool.forEachColumn([&](const auto& column) {
+        writer.beginSection(sizeof(*column.data()));
+        writer.add(column.data(), column.size() * sizeof(*column.data()));
+    });
+    writer.beginSection(1);
+    words.forEachChunk([&](const char* chunk, size_t bytes) { writer.add(chunk, bytes); });
+    const uint32_t state[] = {epoch};
+    writer.beginSection(sizeof(uint32_t));
+    writer.add(state, sizeof(state));
+    return writer.write(fileName);
+}
+
+bool Trie::loadSnapshot(const std::string& fileName, uint64_t source, bool verify)
+{
+    Snapshot::File file;
+    if (!file.open(fileName, source, verify))
+        return false;
+    if (bool(file.flags() & Snapshot::Compressed) != compressed)
+        return false;
+
+    size_t columns = 0;
+    bool matches = true;
+    pool.forEachColumn([&](const auto& column) {
+        matches = matches && columns < file.sections() && file.elementSize(columns) == sizeof(*column.data());
+        ++columns;
+    });
+    WordStore mappedWords;
+    if (!matches || file.sections() != columns + 2 || file.sectionBytes(0) == 0
+        || file.elementSize(columns + 1) != sizeof(uint32_t) || file.sectionBytes(columns + 1) < sizeof(uint32_t)
+        || !mappedWords.map(file.section(columns), file.sectionBytes(columns)))
+        return false;
+    uint32_t state;
+    std::memcpy(&state, file.section(columns + 1), sizeof(state));
+    if (state > UINT16_MAX)
+        return false;
+
+    auto mapColumns = [&](NodePool& target) {
+        size_t index = 0;
+        target.forEachColumn([&](auto& column) {
+            using Item = std::remove_pointer_t<decltype(column.data())>;
+            column.map(reinterpret_cast<Item*>(file.section(index)), file.sectionBytes(index) / sizeof(Item));
+            ++index;
+        });
+    };
+    // Otherwise indices are only bounds-checked as queries follow them, so
+    // that loading stays independent of the size of the trie.
+    if (verify) {
+        NodePool mapped;
+        mapColumns(mapped);
+        if (!mapped.wellFormed())
+            return false;
+        for (size_t i = 0; i < mapped.slots(); ++i) {
+            const TrieNode& n = mapped[uint32_t(i)];
+            if (n.word == WordStore::none ? n.frequency > 0 : !mappedWords.contains(n.word))
+                return false;
         }
     }
-    return "^" + regexPattern + "$";
+
+    clear();
+    mapColumns(pool);
+    words = std::move(mappedWords);
+    snapshot.swap(file);
+    wordCount = size_t(snapshot.words());
+    epoch = uint16_t(state);
+    changed = false;
+    return true;
 }
 
-bool Trie::isValidRegex(const std::string& word, const std::string& pattern) {
-    QString qPattern = QString::fromStdString(pattern);
-    QString regexStr = convertToRegex(qPattern);
-    QRegularExpression regex(regexStr);
+std::unique_lock<std::mutex> Trie::lockForEdit()
+{
+    std::unique_lock<std::mutex> lock(editMutex, std::defer_lock);
+    // Every attempt interrupts the query holding the lock, so one that took
+    // it just before the first attempt is stopped by the next.
+    while (!lock.try_lock()) {
+        interruptQueries();
+        std::this_thread::yield();
+    }
+    return lock;
+}
 
-    if (!regex.isValid()) return false;
+Trie::QueryLock::QueryLock(Trie& trie) : trie(&trie), lock(trie.editMutex)
+{
+    trie.scratch.stopOnChange(&trie.interrupts, trie.interrupts.load(std::memory_order_relaxed));
+}
 
-    QRegularExpressionMatch match = regex.match(QString::fromStdString(word));
-    return match.hasMatch();
+Trie::QueryLock::~QueryLock()
+{
+    // Still under the lock, which is released after this.
+    if (lock.owns_lock())
+        trie->scratch.stopOnChange(nullptr, 0);
+}
+
+size_t Trie::memoryUsage() const
+{
+    return pool.bytes() + words.bytes() + cache.bytes();
+}
+
+void Trie::setCompletionCache(int depth, int k)
+{
+    cache.configure(depth, k);
+}
+
+double Trie::bytesPerWord() const
+{
+    return wordCount ? double(memoryUsage()) / wordCount : 0.0;
 }
@@ -1,4 +1,12 @@
 #include "trienode.h"
 TrieNode::TrieNode() {
     frequency = -1;
+    best = -1;
+    children = none;
+    label = 0;
+    word = none;
+    labelLength = 0;
+    count = 0;
+    epoch = 0;
+    kind = Leaf;
 }
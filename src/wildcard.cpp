@@ -0,0 +1,86 @@
+#include "wildcard.h"
+#include <algorithm>
+
+namespace {
+bool isContinuation(unsigned char byte)
+{
+    return (byte & 0xC0) == 0x80;
+}
+}
+
+WildcardPattern::WildcardPattern(std::string_view pattern) : length(pattern.size())
+{
+    std::fill(std::begin(literals), std::end(literals), 0);
+    if (!compiled())
+        return;
+    for (size_t i = 0; i < length; ++i) {
+        uint64_t bit = uint64_t(1) << i;
+        if (pattern[i] == '.') {
+            dots |= bit;
+            afterDots |= bit << 1;
+        } else if (pattern[i] == '*') {
+            stars |= bit;
+        } else {
+            literals[(unsigned char)pattern[i]] |= bit;
+        }
+    }
+}
+
+uint64_t WildcardPattern::closure(uint64_t states) const
+{
+    // A '*' may match nothing, so reaching it also reaches what follows.
+    uint64_t previous;
+    do {
+        previous = states;
+        states |= (states & stars) << 1;
+    } while (states != previous);
+    return states;
+}
+
+uint64_t WildcardPattern::step(uint64_t states, unsigned char byte) const
+{
+    uint64_t next = ((states & literals[byte]) << 1) | (states & stars);
+    if (isContinuation(byte))
+        next |= states & afterDots;
+    else
+        next |= (states & dots) << 1;
+    return next ? closure(next) : 0;
+}
+
+bool WildcardPattern::matches(std::string_view word, std::string_view pattern)
+{
+    if (pattern.size() <= maxLength) {
+        WildcardPattern compiled(pattern);
+        uint64_t states = compiled.start();
+        for (size_t i = 0; i < word.size() && states; ++i)
+            states = compiled.step(states, (unsigned char)word[i]);
+        return compiled.accepts(states);
+    }
+
+    // Backtracking match for long patterns: remember the last '*' and how
+    // much of the word it had swallowed, and widen it on a mismatch.
+    size_t w = 0, p = 0;
+    size_t starP = std::string_view::npos, starW = 0;
+    while (w < word.size()) {
+        if (p < pattern.size() && pattern[p] == '*') {
+            starP = p++;
+            starW = w;
+        } else if (p < pattern.size() && pattern[p] == '.' && !isContinuation((unsigned char)word[w])) {
+            ++p;
+            ++w;
+            while (w < word.size() && isContinuation((unsigned char)word[w]))
+                ++w;
+        } else if (p < pattern.size() && pattern[p] == word[w]) {
+            ++p;
+            ++w;
+        } else if (starP != std::string_view::npos) {
+            p = starP + 1;
+            w = ++starW;
+        } else {
+            return false;
+        }
+    }
+    while (p < pattern.size() && pattern[p] == '*')
+        ++p;
+    return p == pattern.size();
+}
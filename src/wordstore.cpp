@@ -0,0 +1,123 @@
+#include "wordstore.h"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+WordStore::WordStore(const WordStore &other)
+{
+    *this = other;
+}
+
+WordStore &WordStore::operator=(const WordStore &other)
+{
+    if (this == &other)
+        return *this;
+    clear();
+    other.forEachChunk([this](const char *chunk, size_t bytes) {
+        owned.emplace_back(new char[bytes]);
+        std::memcpy(owned.back().get(), chunk, bytes);
+        chunks.push_back(owned.back().get());
+        if (bytes > chunkSize) {
+            ++oversizedChunks;
+            oversizedBytes += bytes;
+        }
+    });
+    used = other.used;
+    return *this;
+}
+
+uint32_t WordStore::add(std::string_view word)
+{
+    size_t needed = header + word.size();
+    if (chunks.size() >= (size_t(1) << 16) - 1)
+        throw std::length_error("WordStore: handle space exhausted");
+
+    if (needed > chunkSize) {
+        // Words longer than a chunk get a chunk of their own.
+        owned.emplace_back(new char[needed]);
+        chunks.push_back(owned.back().get());
+        ++oversizedChunks;
+        oversizedBytes += needed;
+        used = chunkSize;
+    } else if (used + needed > chunkSize) {
+        // Zeroed, so the unused tail of a chunk is well defined in snapshots.
+        owned.emplace_back(new char[chunkSize]());
+        chunks.push_back(owned.back().get());
+        used = 0;
+    }
+
+    char *chunk = owned.back().get();
+    size_t offset = needed > chunkSize ? 0 : used;
+    uint32_t length = uint32_t(word.size());
+    std::memcpy(chunk + offset, &length, header);
+    std::memcpy(chunk + offset + header, word.data(), word.size());
+    if (needed <= chunkSize)
+        used += needed;
+    return uint32_t((chunks.size() - 1) << 16 | offset);
+}
+
+std::string_view WordStore::get(uint32_t handle) const
+{
+    if (!contains(handle))
+        return std::string_view();
+    const char *entry = chunks[handle >> 16] + (handle & 0xFFFF);
+    uint32_t length;
+    std::memcpy(&length, entry, header);
+    return std::string_view(entry + header, length);
+}
+
+bool WordStore::contains(uint32_t handle) const
+{
+    size_t chunk = handle >> 16;
+    size_t offset = handle & 0xFFFF;
+    if (chunk >= chunks.size() || offset + header > chunkBytes(chunks[chunk]))
+        return false;
+    uint32_t length;
+    std::memcpy(&length, chunks[chunk] + offset, header);
+    return offset + header + length <= chunkBytes(chunks[chunk]);
+}
+
+void WordStore::clear()
+{
+    std::vector<const char *>().swap(chunks);
+    std::vector<std::unique_ptr<char[]>>().swap(owned);
+    used = chunkSize;
+    oversizedChunks = 0;
+    oversizedBytes = 0;
+}
+
+size_t WordStore::bytes() const
+{
+    size_t regular = (owned.size() - oversizedChunks) * chunkSize;
+    return sizeof(WordStore) + chunks.capacity() * sizeof(chunks[0]) + owned.capacity() * sizeof(owned[0])
+           + regular + oversizedBytes;
+}
+
+// A chunk is oversized exactly when its first word does not fit a regular
+// one, in which case that word is all it holds.
+size_t WordStore::chunkBytes(const char *chunk)
+{
+    uint32_t length;
+    std::memcpy(&length, chunk, header);
+    return std::max(chunkSize, header + length);
+}
+
+bool WordStore::map(const char *data, size_t bytes)
+{
+    clear();
+    size_t offset = 0;
+    while (offset < bytes) {
+        if (bytes - offset < header || chunks.size() >= (size_t(1) << 16) - 1) {
+            clear();
+            return false;
+        }
+        size_t size = chunkBytes(data + offset);
+        if (size > bytes - offset) {
+            clear();
+            return false;
+        }
+        chunks.push_back(data + offset);
+        offset += size;
+    }
+    return true;
+}
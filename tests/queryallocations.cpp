@@ -0,0 +1,102 @@
+// Checks that completion queries through a warmed-up QueryContext do no
+// heap allocation: every operator new is counted, the queries are run once
+// to grow the context, and running them again must not allocate.
+
+#include "querycontext.h"
+#include "synthetic.h"
+#include "trie.h"
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <vector>
+
+namespace {
+std::atomic<size_t> allocations{0};
+}
+
+void *operator new(size_t size)
+{
+    ++allocations;
+    if (void *p = std::malloc(size ? size : 1))
+        return p;
+    throw std::bad_alloc();
+}
+
+void *operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void operator delete(void *p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete[](void *p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void *p, size_t) noexcept
+{
+    std::free(p);
+}
+
+void operator delete[](void *p, size_t) noexcept
+{
+    std::free(p);
+}
+
+int main()
+{
+    SyntheticDictionary data = makeSyntheticDictionary(50000, 42);
+    if (allocations == 0) {
+        std::printf("operator new is not being counted\n");
+        return EXIT_FAILURE;
+    }
+    std::vector<std::string> queries;
+    for (size_t i = 0; i < 2000; i += 7) {
+        const std::string &word = data.words[i];
+        for (size_t length = 1; length <= word.size() && length <= 4; ++length)
+            queries.push_back(word.substr(0, length));
+    }
+    // Wildcard queries, both after a literal prefix and from the root.
+    for (const char *pattern : {"t*", "th.*", "a.e*", "*ing", ".e*r", "s*t*", "..", "*"})
+        queries.push_back(pattern);
+
+    int failures = 0;
+    for (bool compressed : {false, true}) {
+        Trie trie(compressed);
+        for (size_t i = 0; i < data.words.size(); ++i)
+            trie.insert(data.words[i], data.frequencies[i]);
+
+        QueryContext context;
+        std::string_view out[10];
+        auto run = [&](bool bfs, bool usefreq) {
+            size_t found = 0;
+            for (const std::string &query : queries)
+                found += trie.autoComplete(context, query, bfs, usefreq, out, 10);
+            return found;
+        };
+        for (int bfs = 0; bfs < 2; ++bfs) {
+            for (int usefreq = 0; usefreq < 2; ++usefreq)
+                run(bfs, usefreq);
+        }
+
+        for (int bfs = 0; bfs < 2; ++bfs) {
+            for (int usefreq = 0; usefreq < 2; ++usefreq) {
+                size_t before = allocations;
+                size_t found = run(bfs, usefreq);
+                size_t made = allocations - before;
+                std::printf("compressed=%d bfs=%d freq=%d: %zu queries, %zu results, %zu allocations\n",
+                            compressed, bfs, usefreq, queries.size(), found, made);
+                if (made != 0 || found == 0)
+                    ++failures;
+            }
+        }
+    }
+    return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}